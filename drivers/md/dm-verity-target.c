@@ -12,6 +12,22 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * In "/sys/module/dm_verity/parameters/parallel_io_size" you can set the size
+ * in bytes above which newly created targets split reads, so that the blocks
+ * of a large read are verified by several kverityd workers in parallel.
+ * Zero (the default) leaves reads unsplit.
+ *
+ * The prefetch cluster adapts to the access pattern of each region of the
+ * data device: regions read sequentially get up to DM_VERITY_PREFETCH_SEQ_MAX
+ * doublings of "prefetch_cluster", randomly read regions get no cluster.
+ *
+ * If "/sys/module/dm_verity/parameters/prefetch_trace_secs" is non-zero when a
+ * target is created, the level 0 hash blocks it reads during that many seconds
+ * are recorded and can be read from debugfs as "dm-verity/<device name>".
+ * Userspace can store that list and pass it back on the next boot with the
+ * "prefetch_replay <start>[-<end>]..." target message, which prefetches those
+ * hash blocks before they are needed.
  */
 
 #include "dm-verity.h"
@@ -21,6 +37,8 @@
 #include <linux/module.h>
 #include <linux/reboot.h>
 #include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/ctype.h>
 #if defined(CONFIG_TZ_ICCC)
@@ -37,12 +55,20 @@
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
+#define DM_VERITY_PREFETCH_SEQ_MAX	4
+#define DM_VERITY_TRACE_MAX		8192
+
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
 #define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
+#define DM_VERITY_OPT_AT_MOST_ONCE_KB	"check_at_most_once_max_kb"
+
+#define DM_VERITY_OPTS_MAX		(5 + DM_VERITY_OPTS_FEC)
 
-#define DM_VERITY_OPTS_MAX		(2 + DM_VERITY_OPTS_FEC)
+/* Number of data blocks covered by one chunk of the validated bitset */
+#define DM_VERITY_CHUNK_SHIFT		(PAGE_SHIFT + 3)
+#define DM_VERITY_CHUNK_BITS		(1UL << DM_VERITY_CHUNK_SHIFT)
 
 #ifdef VERIFY_META_ONLY
 extern struct rb_root *ext4_system_zone_root(struct super_block *sb);
@@ -58,12 +84,17 @@ int start_meta;
 #endif
 
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
+static unsigned dm_verity_parallel_io_size;
+static unsigned dm_verity_prefetch_trace_secs;
+static struct dentry *dm_verity_debugfs_dir;
 
 ulong gTotalBlock = 0;
 ulong gMetaTotalBlock = 0;
 module_param_named(total, gTotalBlock, ulong, 0444);
 module_param_named(mtotal, gMetaTotalBlock, ulong, 0444);
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
+module_param_named(parallel_io_size, dm_verity_parallel_io_size, uint, S_IRUGO | S_IWUSR);
+module_param_named(prefetch_trace_secs, dm_verity_prefetch_trace_secs, uint, S_IRUGO | S_IWUSR);
 
 #ifdef DMV_ALTA
 /* Verity bitmap. Each bit represents one block and will be set when integrity
@@ -86,6 +117,7 @@ struct dm_verity_prefetch_work {
 	struct dm_verity *v;
 	sector_t block;
 	unsigned n_blocks;
+	unsigned cluster;
 };
 
 /*
@@ -122,6 +154,62 @@ static sector_t verity_map_sector(struct dm_verity *v, sector_t bi_sector)
 	return v->data_start + dm_target_offset(v->ti, bi_sector);
 }
 
+/*
+ * Allocate the chunk of the validated bitset in *slot, unless that would
+ * exceed the memory limit.  Runs in the I/O path, so it must not recurse into
+ * the block layer or dip into reserves; failing just means no caching.
+ */
+static unsigned long *verity_alloc_validated_chunk(struct dm_verity *v,
+						   unsigned long **slot)
+{
+	unsigned long *chunk, *old;
+
+	if (atomic_inc_return(&v->validated_used_chunks) >
+	    v->validated_max_chunks && v->validated_max_chunks)
+		goto undo;
+
+	chunk = (unsigned long *)get_zeroed_page(GFP_NOIO | __GFP_NORETRY |
+						 __GFP_NOMEMALLOC |
+						 __GFP_NOWARN);
+	if (!chunk)
+		goto undo;
+
+	old = cmpxchg(slot, NULL, chunk);
+	if (old) {
+		free_page((unsigned long)chunk);
+		atomic_dec(&v->validated_used_chunks);
+		return old;
+	}
+	return chunk;
+
+undo:
+	atomic_dec(&v->validated_used_chunks);
+	return NULL;
+}
+
+static bool verity_is_block_validated(struct dm_verity *v, sector_t block)
+{
+	unsigned long *chunk;
+
+	chunk = READ_ONCE(v->validated_chunks[block >> DM_VERITY_CHUNK_SHIFT]);
+
+	return chunk && test_bit(block & (DM_VERITY_CHUNK_BITS - 1), chunk);
+}
+
+static void verity_set_block_validated(struct dm_verity *v, sector_t block)
+{
+	unsigned long **slot = &v->validated_chunks[block >> DM_VERITY_CHUNK_SHIFT];
+	unsigned long *chunk = READ_ONCE(*slot);
+
+	if (unlikely(!chunk)) {
+		chunk = verity_alloc_validated_chunk(v, slot);
+		if (!chunk)
+			return;
+	}
+
+	set_bit(block & (DM_VERITY_CHUNK_BITS - 1), chunk);
+}
+
 /*
  * Return hash position of a specified block at a specified tree level
  * (0 is the lowest level).
@@ -144,6 +232,14 @@ static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
 	desc->tfm = v->tfm;
 	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
 
+	if (likely(v->initial_hashstate)) {
+		r = crypto_shash_import(desc, v->initial_hashstate);
+
+		if (unlikely(r < 0))
+			DMERR("crypto_shash_import failed: %d", r);
+		return r;
+	}
+
 	r = crypto_shash_init(desc);
 
 	if (unlikely(r < 0)) {
@@ -322,6 +418,14 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 	aux = dm_bufio_get_aux_data(buf);
 
+	/*
+	 * With check_at_most_once, a hash block verified before dm-bufio
+	 * evicted it need not be hashed again.
+	 */
+	if (!aux->hash_verified && v->validated_hash_blocks &&
+	    test_bit(hash_block - v->hash_start, v->validated_hash_blocks))
+		aux->hash_verified = 1;
+
 	if (!aux->hash_verified) {
 		if (skip_unverified) {
 			r = 1;
@@ -335,9 +439,12 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 			goto release_ret_r;
 
 		if (likely(memcmp(verity_io_real_digest(v, io), want_digest,
-				  v->digest_size) == 0))
+				  v->digest_size) == 0)) {
 			aux->hash_verified = 1;
-		else if (verity_fec_decode(v, io,
+			if (v->validated_hash_blocks)
+				set_bit(hash_block - v->hash_start,
+					v->validated_hash_blocks);
+		} else if (verity_fec_decode(v, io,
 					DM_VERITY_BLOCK_TYPE_METADATA,
 					hash_block, data, NULL) == 0) {
 #ifdef SEC_HEX_DEBUG
@@ -486,8 +593,8 @@ static int verity_verify_io(struct dm_verity_io *io)
 		sector_t cur_block = io->block + b;
 		struct shash_desc *desc = verity_io_hash_desc(v, io);
 
-		if (v->validated_blocks &&
-		    likely(test_bit(cur_block, v->validated_blocks))) {
+		if (v->validated_chunks &&
+		    likely(verity_is_block_validated(v, cur_block))) {
 			verity_bv_skip_block(v, io, &io->iter);
 #ifdef SEC_HEX_DEBUG
 			add_skipped_blks();
@@ -529,8 +636,8 @@ static int verity_verify_io(struct dm_verity_io *io)
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
-			if (v->validated_blocks)
-				set_bit(cur_block, v->validated_blocks);
+			if (v->validated_chunks)
+				verity_set_block_validated(v, cur_block);
 #ifdef DMV_ALTA
 			set_bit(io->block + b, (volatile unsigned long *)io->v->verity_bitmap);
 #endif
@@ -639,7 +746,7 @@ static void verity_prefetch_io(struct work_struct *work)
 		verity_hash_at_level(v, pw->block, i, &hash_block_start, NULL);
 		verity_hash_at_level(v, pw->block + pw->n_blocks - 1, i, &hash_block_end, NULL);
 		if (!i) {
-			unsigned cluster = ACCESS_ONCE(dm_verity_prefetch_cluster);
+			unsigned cluster = pw->cluster;
 
 			cluster >>= v->data_dev_block_bits;
 			if (unlikely(!cluster))
@@ -661,19 +768,100 @@ no_prefetch_cluster:
 	kfree(pw);
 }
 
+/*
+ * Learn whether the region containing "block" is read sequentially and return
+ * the prefetch cluster to use for it.  The per-region state is updated without
+ * locking; a race can at worst mispredict one prefetch.
+ */
+static unsigned verity_adapt_cluster(struct dm_verity *v, sector_t block,
+				     unsigned n_blocks)
+{
+	unsigned cluster = ACCESS_ONCE(dm_verity_prefetch_cluster);
+	sector_t region_mask = ((sector_t)1 << v->region_shift) - 1;
+	sector_t idx = block >> v->region_shift;
+	struct dm_verity_region *r;
+	sector_t next;
+	u8 seq;
+
+	if (!v->regions)
+		return cluster;
+
+	r = &v->regions[idx];
+	seq = r->seq;
+	if ((block & region_mask) == r->next) {
+		if (seq < DM_VERITY_PREFETCH_SEQ_MAX)
+			seq++;
+	} else if (seq) {
+		seq--;
+	}
+	r->seq = seq;
+
+	/* A stream leaving this region continues in the next one */
+	next = (block & region_mask) + n_blocks;
+	if (next > region_mask) {
+		if (((block + n_blocks) >> v->region_shift) <
+		    ((v->data_blocks + region_mask) >> v->region_shift)) {
+			r = &v->regions[(block + n_blocks) >> v->region_shift];
+			r->seq = max(r->seq, seq);
+			r->next = (block + n_blocks) & region_mask;
+		}
+	} else {
+		r->next = next;
+	}
+
+	if (!seq)
+		return 0;
+	return cluster << (seq - 1);
+}
+
+/*
+ * Record the level 0 hash blocks covering the given data blocks in the boot
+ * trace, each the first time it is seen.
+ */
+static void verity_trace_blocks(struct dm_verity *v, sector_t block,
+				unsigned n_blocks)
+{
+	sector_t hash_block, hash_end;
+	unsigned long flags;
+
+	if (!v->trace || !v->levels || time_after(jiffies, v->trace_until))
+		return;
+
+	verity_hash_at_level(v, block, 0, &hash_block, NULL);
+	verity_hash_at_level(v, block + n_blocks - 1, 0, &hash_end, NULL);
+
+	spin_lock_irqsave(&v->trace_lock, flags);
+	for (; hash_block <= hash_end; hash_block++) {
+		u32 off = hash_block - v->hash_start;
+
+		if (v->trace_len >= DM_VERITY_TRACE_MAX)
+			break;
+		if (!test_and_set_bit(off, v->trace_seen)) {
+			v->trace[v->trace_len] = off;
+			smp_wmb();
+			WRITE_ONCE(v->trace_len, v->trace_len + 1);
+		}
+	}
+	spin_unlock_irqrestore(&v->trace_lock, flags);
+}
+
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
 	sector_t block = io->block;
 	unsigned int n_blocks = io->n_blocks;
 	struct dm_verity_prefetch_work *pw;
+	unsigned cluster;
+
+	cluster = verity_adapt_cluster(v, block, n_blocks);
+	verity_trace_blocks(v, block, n_blocks);
 
-	if (v->validated_blocks) {
-		while (n_blocks && test_bit(block, v->validated_blocks)) {
+	if (v->validated_chunks) {
+		while (n_blocks && verity_is_block_validated(v, block)) {
 			block++;
 			n_blocks--;
 		}
-		while (n_blocks && test_bit(block + n_blocks - 1,
-					v->validated_blocks))
+		while (n_blocks && verity_is_block_validated(v,
+						block + n_blocks - 1))
 			n_blocks--;
 		if (!n_blocks)
 			return;
@@ -689,6 +877,7 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 	pw->v = v;
 	pw->block = block;
 	pw->n_blocks = n_blocks;
+	pw->cluster = cluster;
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -876,7 +1065,9 @@ void verity_status(struct dm_target *ti, status_type_t type,
 			args += DM_VERITY_OPTS_FEC;
 		if (v->zero_digest)
 			args++;
-		if (v->validated_blocks)
+		if (v->validated_max_kb)
+			args += 2;
+		else if (v->validated_chunks)
 			args++;
 		if (!args)
 			return;
@@ -896,7 +1087,10 @@ void verity_status(struct dm_target *ti, status_type_t type,
 		}
 		if (v->zero_digest)
 			DMEMIT(" " DM_VERITY_OPT_IGN_ZEROES);
-		if (v->validated_blocks)
+		if (v->validated_max_kb)
+			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE_KB " %u",
+			       v->validated_max_kb);
+		else if (v->validated_chunks)
 			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
 		sz = verity_fec_status_table(v, sz, result, maxlen);
 		break;
@@ -904,6 +1098,79 @@ void verity_status(struct dm_target *ti, status_type_t type,
 }
 EXPORT_SYMBOL_GPL(verity_status);
 
+/*
+ * Target messages:
+ *	prefetch_replay <start>[-<end>]...
+ *		Prefetch the given ranges of hash blocks, numbered from the
+ *		hash start block as in the debugfs trace.
+ */
+static int verity_message(struct dm_target *ti, unsigned argc, char **argv)
+{
+	struct dm_verity *v = ti->private;
+	sector_t nr_hash_blocks = v->hash_blocks - v->hash_start;
+	unsigned long long start, end;
+	char dummy;
+	unsigned i;
+
+	if (argc < 1 || strcasecmp(argv[0], "prefetch_replay")) {
+		DMWARN("Unrecognised message received.");
+		return -EINVAL;
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (sscanf(argv[i], "%llu-%llu%c", &start, &end, &dummy) != 2) {
+			if (sscanf(argv[i], "%llu%c", &start, &dummy) != 1) {
+				DMWARN("Invalid prefetch range %s", argv[i]);
+				return -EINVAL;
+			}
+			end = start;
+		}
+		if (start > end || end >= nr_hash_blocks)
+			continue;
+
+		dm_bufio_prefetch(v->bufio, v->hash_start + start,
+				  end - start + 1);
+	}
+
+	return 0;
+}
+
+static int verity_trace_show(struct seq_file *m, void *unused)
+{
+	struct dm_verity *v = m->private;
+	unsigned i, len;
+	u32 start, end;
+
+	len = READ_ONCE(v->trace_len);
+	smp_rmb();
+
+	for (i = 0; i < len; i++) {
+		start = end = v->trace[i];
+		while (i + 1 < len && v->trace[i + 1] == end + 1)
+			end = v->trace[++i];
+
+		if (start == end)
+			seq_printf(m, "%u\n", start);
+		else
+			seq_printf(m, "%u-%u\n", start, end);
+	}
+
+	return 0;
+}
+
+static int verity_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, verity_trace_show, inode->i_private);
+}
+
+static const struct file_operations verity_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= verity_trace_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int verity_prepare_ioctl(struct dm_target *ti,
 		struct block_device **bdev, fmode_t *mode)
 {
@@ -944,6 +1211,7 @@ EXPORT_SYMBOL_GPL(verity_io_hints);
 void verity_dtr(struct dm_target *ti)
 {
 	struct dm_verity *v = ti->private;
+	unsigned i;
 	
 #ifdef DMV_ALTA
     if (v->verity_bitmap) {
@@ -956,10 +1224,20 @@ void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
-	vfree(v->validated_blocks);
+	if (v->validated_chunks) {
+		for (i = 0; i < v->validated_nr_chunks; i++)
+			free_page((unsigned long)v->validated_chunks[i]);
+		vfree(v->validated_chunks);
+	}
+	vfree(v->validated_hash_blocks);
+	debugfs_remove(v->trace_dentry);
+	vfree(v->trace);
+	vfree(v->trace_seen);
+	vfree(v->regions);
 	kfree(v->salt);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
+	kfree(v->initial_hashstate);
 
 	if (v->tfm)
 		crypto_free_shash(v->tfm);
@@ -981,16 +1259,22 @@ EXPORT_SYMBOL_GPL(verity_dtr);
 static int verity_alloc_most_once(struct dm_verity *v)
 {
 	struct dm_target *ti = v->ti;
+	sector_t nr_chunks;
+
+	if (v->validated_chunks)
+		return 0;
 
-	/* the bitset can only handle INT_MAX blocks */
-	if (v->data_blocks > INT_MAX) {
+	nr_chunks = (v->data_blocks + DM_VERITY_CHUNK_BITS - 1) >>
+		    DM_VERITY_CHUNK_SHIFT;
+	if (nr_chunks > INT_MAX / sizeof(unsigned long *)) {
 		ti->error = "device too large to use check_at_most_once";
 		return -E2BIG;
 	}
 
-	v->validated_blocks = vzalloc(BITS_TO_LONGS(v->data_blocks) *
-				       sizeof(unsigned long));
-	if (!v->validated_blocks) {
+	v->validated_nr_chunks = nr_chunks;
+	v->validated_chunks = vzalloc(max_t(size_t, nr_chunks, 1) *
+				      sizeof(unsigned long *));
+	if (!v->validated_chunks) {
 		ti->error = "failed to allocate bitset for check_at_most_once";
 		return -ENOMEM;
 	}
@@ -998,6 +1282,57 @@ static int verity_alloc_most_once(struct dm_verity *v)
 	return 0;
 }
 
+/*
+ * The hash tree is tiny compared to the data, so validated hash blocks are
+ * tracked in a flat bitset outside the check_at_most_once memory limit.
+ */
+static int verity_alloc_most_once_hash(struct dm_verity *v)
+{
+	sector_t nr_blocks = v->hash_blocks - v->hash_start;
+
+	if (nr_blocks > INT_MAX) {
+		v->ti->error = "hash tree too large to use check_at_most_once";
+		return -E2BIG;
+	}
+
+	v->validated_hash_blocks = vzalloc(BITS_TO_LONGS(nr_blocks) *
+					   sizeof(unsigned long));
+	if (!v->validated_hash_blocks) {
+		v->ti->error = "failed to allocate hash bitset for check_at_most_once";
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Hash the salt once and keep the resulting state, so that each block only
+ * needs to import it instead of re-hashing the salt.  Format 0 appends the
+ * salt instead, and not every hash can export its state; those just keep
+ * using verity_hash_init() the slow way.
+ */
+static void verity_setup_salted_state(struct dm_verity *v)
+{
+	struct shash_desc *desc;
+	u8 *state;
+
+	if (!v->version || !v->salt_size)
+		return;
+
+	desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+	state = kmalloc(crypto_shash_statesize(v->tfm), GFP_KERNEL);
+	if (!desc || !state)
+		goto out;
+
+	if (!verity_hash_init(v, desc) && !crypto_shash_export(desc, state)) {
+		v->initial_hashstate = state;
+		state = NULL;
+	}
+out:
+	kfree(desc);
+	kfree(state);
+}
+
 static int verity_alloc_zero_digest(struct dm_verity *v)
 {
 	int r = -ENOMEM;
@@ -1029,6 +1364,58 @@ out:
 	return r;
 }
 
+/*
+ * Set up adaptive prefetch.  A region covers the data blocks of one level 0
+ * hash block, but at most 64K blocks so that offsets fit the state.  This is
+ * only an optimization, so allocation failures are not fatal.
+ */
+static void verity_alloc_prefetch_state(struct dm_verity *v)
+{
+	unsigned trace_secs = ACCESS_ONCE(dm_verity_prefetch_trace_secs);
+	sector_t nr_regions, nr_hash_blocks;
+
+	v->region_shift = min_t(unsigned char, v->hash_per_block_bits, 16);
+	nr_regions = (v->data_blocks + ((sector_t)1 << v->region_shift) - 1) >>
+		     v->region_shift;
+	if (nr_regions && nr_regions <= INT_MAX / sizeof(struct dm_verity_region))
+		v->regions = vzalloc(nr_regions *
+				     sizeof(struct dm_verity_region));
+
+	spin_lock_init(&v->trace_lock);
+	nr_hash_blocks = v->hash_blocks - v->hash_start;
+	if (!trace_secs || !dm_verity_debugfs_dir || !nr_hash_blocks ||
+	    nr_hash_blocks > INT_MAX)
+		return;
+
+	v->trace = vmalloc(DM_VERITY_TRACE_MAX * sizeof(u32));
+	v->trace_seen = vzalloc(BITS_TO_LONGS(nr_hash_blocks) *
+				sizeof(unsigned long));
+	if (!v->trace || !v->trace_seen) {
+		vfree(v->trace);
+		vfree(v->trace_seen);
+		v->trace = NULL;
+		v->trace_seen = NULL;
+		return;
+	}
+	v->trace_until = jiffies + trace_secs * HZ;
+	v->trace_dentry = debugfs_create_file(
+			dm_device_name(dm_table_get_md(v->ti->table)), S_IRUSR,
+			dm_verity_debugfs_dir, v, &verity_trace_fops);
+}
+
+/*
+ * The levels above level 0 are a tiny fraction of the hash tree and every
+ * read at boot needs them, so start reading them all as soon as possible.
+ */
+static void verity_prefetch_upper_levels(struct dm_verity *v)
+{
+	if (v->levels < 2)
+		return;
+
+	dm_bufio_prefetch(v->bufio, v->hash_start,
+			  v->hash_level_block[0] - v->hash_start);
+}
+
 static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v)
 {
 	int r;
@@ -1073,6 +1460,25 @@ static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v)
 				return r;
 			continue;
 
+		} else if (!strcasecmp(arg_name, DM_VERITY_OPT_AT_MOST_ONCE_KB) &&
+			   argc) {
+			unsigned max_kb;
+			char dummy;
+
+			if (sscanf(dm_shift_arg(as), "%u%c", &max_kb,
+				   &dummy) != 1 || !max_kb) {
+				ti->error = "Invalid " DM_VERITY_OPT_AT_MOST_ONCE_KB;
+				return -EINVAL;
+			}
+			argc--;
+			v->validated_max_kb = max_kb;
+			v->validated_max_chunks =
+				DIV_ROUND_UP(max_kb, PAGE_SIZE >> 10);
+			r = verity_alloc_most_once(v);
+			if (r)
+				return r;
+			continue;
+
 		} else if (verity_is_fec_opt_arg(arg_name)) {
 			r = verity_fec_parse_opt_args(as, v, &argc, arg_name);
 			if (r)
@@ -1252,6 +1658,8 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	verity_setup_salted_state(v);
+
 	argv += 10;
 	argc -= 10;
 
@@ -1270,7 +1678,7 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 #endif
 
 #ifdef CONFIG_DM_ANDROID_VERITY_AT_MOST_ONCE_DEFAULT_ENABLED
-	if (!v->validated_blocks) {
+	if (!v->validated_chunks) {
 		r = verity_alloc_most_once(v);
 		if (r)
 			goto bad;
@@ -1324,6 +1732,26 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	if (v->validated_chunks) {
+		r = verity_alloc_most_once_hash(v);
+		if (r)
+			goto bad;
+	}
+
+	verity_alloc_prefetch_state(v);
+
+	/*
+	 * Blocks of one bio are verified sequentially, so large reads are split
+	 * for their pieces to be verified concurrently on the unbound workqueue.
+	 */
+	num = ACCESS_ONCE(dm_verity_parallel_io_size) >> v->data_dev_block_bits;
+	if (num) {
+		r = dm_set_target_max_io_len(ti,
+			(sector_t)num << (v->data_dev_block_bits - SECTOR_SHIFT));
+		if (r)
+			goto bad;
+	}
+
 	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
 	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
 	if (!v->verify_wq) {
@@ -1351,6 +1779,8 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	ti->per_bio_data_size = roundup(ti->per_bio_data_size,
 					__alignof__(struct dm_verity_io));
 
+	verity_prefetch_upper_levels(v);
+
 #ifdef SEC_HEX_DEBUG
 	if (!verity_fec_is_enabled(v))
 		add_fec_off_cnt(v->data_dev->name);
@@ -1372,12 +1802,13 @@ EXPORT_SYMBOL_GPL(verity_ctr);
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 4, 0},
+	.version	= {1, 6, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
 	.map		= verity_map,
 	.status		= verity_status,
+	.message	= verity_message,
 	.prepare_ioctl	= verity_prepare_ioctl,
 	.iterate_devices = verity_iterate_devices,
 	.io_hints	= verity_io_hints,
@@ -1387,9 +1818,15 @@ static int __init dm_verity_init(void)
 {
 	int r;
 
+	dm_verity_debugfs_dir = debugfs_create_dir("dm-verity", NULL);
+	if (IS_ERR(dm_verity_debugfs_dir))
+		dm_verity_debugfs_dir = NULL;
+
 	r = dm_register_target(&verity_target);
-	if (r < 0)
+	if (r < 0) {
 		DMERR("register failed %d", r);
+		debugfs_remove(dm_verity_debugfs_dir);
+	}
 
 	return r;
 }
@@ -1397,6 +1834,7 @@ static int __init dm_verity_init(void)
 static void __exit dm_verity_exit(void)
 {
 	dm_unregister_target(&verity_target);
+	debugfs_remove(dm_verity_debugfs_dir);
 }
 
 module_init(dm_verity_init);
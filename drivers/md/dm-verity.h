@@ -33,6 +33,12 @@ enum verity_block_type {
 
 struct dm_verity_fec;
 
+/* Access pattern of the data blocks covered by one prefetch region */
+struct dm_verity_region {
+	u16 next;	/* offset of the block a sequential reader reads next */
+	u8 seq;		/* saturating score, 0 means random access */
+};
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -43,6 +49,7 @@ struct dm_verity {
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
 	u8 *zero_digest;	/* digest for a zero block */
+	u8 *initial_hashstate;	/* salted initial hash state, or NULL */
 	unsigned salt_size;
 	sector_t data_start;	/* data offset in 512-byte sectors */
 	sector_t hash_start;	/* hash start in blocks */
@@ -65,7 +72,29 @@ struct dm_verity {
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 
 	struct dm_verity_fec *fec;	/* forward error correction */
-	unsigned long *validated_blocks; /* bitset blocks validated */
+	/*
+	 * check_at_most_once: bitset of validated data blocks, split into
+	 * page-sized chunks that are allocated on first use.  At most
+	 * validated_max_chunks of them are allocated (0 means no limit).
+	 */
+	unsigned long **validated_chunks;
+	unsigned validated_nr_chunks;
+	unsigned validated_max_chunks;
+	atomic_t validated_used_chunks;
+	unsigned validated_max_kb;	/* limit given in the table, or 0 */
+	unsigned long *validated_hash_blocks; /* bitset of validated hash blocks */
+
+	/* adaptive prefetch: per-region access pattern, or NULL */
+	struct dm_verity_region *regions;
+	unsigned char region_shift;	/* log2(data blocks per region) */
+
+	/* boot-time trace of level 0 hash blocks, relative to hash_start */
+	spinlock_t trace_lock;
+	u32 *trace;
+	unsigned trace_len;
+	unsigned long trace_until;	/* jiffies when recording stops */
+	unsigned long *trace_seen;	/* bitset of hash blocks in trace */
+	struct dentry *trace_dentry;
 #ifdef DMV_ALTA
 	u8 *verity_bitmap; /* bitmap for skipping verification on blocks */
 #endif
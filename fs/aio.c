@@ -74,8 +74,19 @@ struct kioctx_table {
 	struct kioctx __rcu	*table[];
 };
 
+/*
+ * Number of completed aio_kiocbs each cpu keeps around for reuse, so a
+ * steady stream of io_submit()/completion doesn't bounce every request
+ * through the slab allocator.
+ */
+#define AIO_KIOCB_CACHE		16
+
+struct aio_kiocb;
+
 struct kioctx_cpu {
 	unsigned		reqs_available;
+	unsigned		nr_free_reqs;
+	struct aio_kiocb	*free_reqs[AIO_KIOCB_CACHE];
 };
 
 struct ctx_rq_wait {
@@ -579,6 +590,23 @@ static int kiocb_cancel(struct aio_kiocb *kiocb)
 	return cancel(&kiocb->common);
 }
 
+/*
+ * Every request holds a ref on ctx->reqs until after kiocb_free(), so by
+ * the time we get here nobody can be touching the per cpu caches.
+ */
+static void aio_drain_req_cache(struct kioctx *ctx)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct kioctx_cpu *kcpu = per_cpu_ptr(ctx->cpu, cpu);
+
+		while (kcpu->nr_free_reqs)
+			kmem_cache_free(kiocb_cachep,
+					kcpu->free_reqs[--kcpu->nr_free_reqs]);
+	}
+}
+
 /*
  * free_ioctx() should be RCU delayed to synchronize against the RCU
  * protected lookup_ioctx() and also needs process context to call
@@ -592,6 +620,7 @@ static void free_ioctx(struct work_struct *work)
 	pr_debug("freeing %p\n", ctx);
 
 	aio_free_ring(ctx);
+	aio_drain_req_cache(ctx);
 	free_percpu(ctx->cpu);
 	percpu_ref_exit(&ctx->reqs);
 	percpu_ref_exit(&ctx->users);
@@ -1015,6 +1044,42 @@ static void user_refill_reqs_available(struct kioctx *ctx)
 	spin_unlock_irq(&ctx->completion_lock);
 }
 
+/*
+ * The per cpu request cache is also fed from aio_complete(), which may run
+ * in irq context, hence local_irq_save() as for reqs_available.
+ */
+static struct aio_kiocb *aio_get_cached_req(struct kioctx *ctx)
+{
+	struct kioctx_cpu *kcpu;
+	struct aio_kiocb *req = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	kcpu = this_cpu_ptr(ctx->cpu);
+	if (kcpu->nr_free_reqs)
+		req = kcpu->free_reqs[--kcpu->nr_free_reqs];
+	local_irq_restore(flags);
+
+	return req;
+}
+
+static bool aio_put_cached_req(struct kioctx *ctx, struct aio_kiocb *req)
+{
+	struct kioctx_cpu *kcpu;
+	bool ret = false;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	kcpu = this_cpu_ptr(ctx->cpu);
+	if (kcpu->nr_free_reqs < AIO_KIOCB_CACHE) {
+		kcpu->free_reqs[kcpu->nr_free_reqs++] = req;
+		ret = true;
+	}
+	local_irq_restore(flags);
+
+	return ret;
+}
+
 /* aio_get_req
  *	Allocate a slot for an aio request.
  * Returns NULL if no requests are free.
@@ -1029,7 +1094,11 @@ static inline struct aio_kiocb *aio_get_req(struct kioctx *ctx)
 			return NULL;
 	}
 
-	req = kmem_cache_alloc(kiocb_cachep, GFP_KERNEL|__GFP_ZERO);
+	req = aio_get_cached_req(ctx);
+	if (req)
+		memset(req, 0, sizeof(*req));
+	else
+		req = kmem_cache_alloc(kiocb_cachep, GFP_KERNEL|__GFP_ZERO);
 	if (unlikely(!req))
 		goto out_put;
 
@@ -1048,7 +1117,8 @@ static void kiocb_free(struct aio_kiocb *req)
 		fput(req->common.ki_filp);
 	if (req->ki_eventfd != NULL)
 		eventfd_ctx_put(req->ki_eventfd);
-	kmem_cache_free(kiocb_cachep, req);
+	if (!aio_put_cached_req(req->ki_ctx, req))
+		kmem_cache_free(kiocb_cachep, req);
 }
 
 static struct kioctx *lookup_ioctx(unsigned long ctx_id)
@@ -1590,8 +1660,8 @@ static int io_submit_one(struct kioctx *ctx, struct iocb __user *user_iocb,
 	return 0;
 out_put_req:
 	put_reqs_available(ctx, 1);
-	percpu_ref_put(&ctx->reqs);
 	kiocb_free(req);
+	percpu_ref_put(&ctx->reqs);
 	return ret;
 }
 
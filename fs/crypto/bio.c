@@ -23,18 +23,30 @@
 #include <linux/module.h>
 #include <linux/bio.h>
 #include <linux/namei.h>
+#include <linux/interrupt.h>
 #include "fscrypt_private.h"
 
-static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
+static unsigned int inline_decrypt_max_pages;
+
+module_param(inline_decrypt_max_pages, uint, 0644);
+MODULE_PARM_DESC(inline_decrypt_max_pages,
+		"Largest read bio, in pages, to decrypt in its completion context (0 to always use the workqueue)");
+
+static void __fscrypt_decrypt_bio(struct bio *bio, bool done, bool inline_ok)
 {
 	struct bio_vec *bv;
 	int i;
 
 	bio_for_each_segment_all(bv, bio, i) {
 		struct page *page = bv->bv_page;
-		int ret = fscrypt_decrypt_page(page->mapping->host, page,
-				PAGE_SIZE, 0, page->index);
-
+		int ret;
+
+		if (inline_ok)
+			ret = fscrypt_decrypt_page_inline(page->mapping->host,
+							  page, page->index);
+		else
+			ret = fscrypt_decrypt_page(page->mapping->host, page,
+						   PAGE_SIZE, 0, page->index);
 		if (ret) {
 			WARN_ON_ONCE(1);
 			SetPageError(page);
@@ -46,25 +58,75 @@ static void __fscrypt_decrypt_bio(struct bio *bio, bool done)
 	}
 }
 
+/*
+ * Decrypting a small bio where it completed avoids a context switch and keeps
+ * the plaintext in the cache of the CPU that finished the I/O.  That is only
+ * possible for synchronous ciphers, and not from hard interrupt context.
+ */
+static bool fscrypt_bio_inline_ok(struct bio *bio)
+{
+	struct bio_vec *bv;
+	int i;
+
+	if (bio->bi_vcnt > READ_ONCE(inline_decrypt_max_pages))
+		return false;
+	if (in_irq() || irqs_disabled())
+		return false;
+
+	bio_for_each_segment_all(bv, bio, i) {
+		if (!fscrypt_inline_decrypt_capable(bv->bv_page->mapping->host))
+			return false;
+	}
+	return true;
+}
+
 void fscrypt_decrypt_bio(struct bio *bio)
 {
-	__fscrypt_decrypt_bio(bio, false);
+	__fscrypt_decrypt_bio(bio, false, false);
 }
 EXPORT_SYMBOL(fscrypt_decrypt_bio);
 
+/**
+ * fscrypt_decrypt_bio_inline() - Decrypts a read bio without deferring
+ * @bio: The completed read bio, whose pages are still locked
+ *
+ * Called from a read completion handler.  Decrypts @bio in the current
+ * context if it is small enough and every page's cipher is synchronous.
+ * Pages that fail to decrypt get PG_error set.
+ *
+ * Return: true if @bio was decrypted, false if the caller must defer the
+ * work to fscrypt_enqueue_decrypt_work().
+ */
+bool fscrypt_decrypt_bio_inline(struct bio *bio)
+{
+	if (!fscrypt_bio_inline_ok(bio))
+		return false;
+
+	__fscrypt_decrypt_bio(bio, false, true);
+	return true;
+}
+EXPORT_SYMBOL(fscrypt_decrypt_bio_inline);
+
 static void completion_pages(struct work_struct *work)
 {
 	struct fscrypt_ctx *ctx =
 		container_of(work, struct fscrypt_ctx, r.work);
 	struct bio *bio = ctx->r.bio;
 
-	__fscrypt_decrypt_bio(bio, true);
+	__fscrypt_decrypt_bio(bio, true, false);
 	fscrypt_release_ctx(ctx);
 	bio_put(bio);
 }
 
 void fscrypt_enqueue_decrypt_bio(struct fscrypt_ctx *ctx, struct bio *bio)
 {
+	if (fscrypt_bio_inline_ok(bio)) {
+		__fscrypt_decrypt_bio(bio, true, true);
+		fscrypt_release_ctx(ctx);
+		bio_put(bio);
+		return;
+	}
+
 	INIT_WORK(&ctx->r.work, completion_pages);
 	ctx->r.bio = bio;
 	fscrypt_enqueue_decrypt_work(&ctx->r.work);
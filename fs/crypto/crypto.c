@@ -26,6 +26,10 @@
 #include <linux/ratelimit.h>
 #include <linux/dcache.h>
 #include <linux/namei.h>
+#include <linux/percpu.h>
+#include <linux/interrupt.h>
+#include <linux/cpu.h>
+#include <linux/shrinker.h>
 #include <crypto/aes.h>
 #include <crypto/skcipher.h>
 #include "fscrypt_private.h"
@@ -45,43 +49,176 @@ static mempool_t *fscrypt_bounce_page_pool = NULL;
 static LIST_HEAD(fscrypt_free_ctxs);
 static DEFINE_SPINLOCK(fscrypt_ctx_lock);
 
+/*
+ * Per-CPU caches of free contexts and bounce pages, so that writeback running
+ * on several CPUs doesn't serialize on fscrypt_ctx_lock and the mempool.  The
+ * size of each cache follows the rate at which its CPU has recently been
+ * allocating bounce pages; anything beyond that goes back to the shared pools.
+ * Since a cache is only resized when its CPU allocates, a shrinker empties
+ * all of them under memory pressure, so that idle CPUs don't pin pages.
+ */
+#define FS_PCP_CACHE_MIN	4
+#define FS_PCP_CACHE_MAX	64
+#define FS_PCP_WINDOW		(HZ / 10)
+
+struct fscrypt_pcp_cache {
+	struct list_head free_ctxs;
+	unsigned int nr_ctxs;
+	unsigned int nr_pages;
+	struct page *pages[FS_PCP_CACHE_MAX];
+	unsigned int high;
+	unsigned int window_allocs;
+	unsigned long window_start;
+};
+
+static struct fscrypt_pcp_cache __percpu *fscrypt_pcp;
+
 static struct workqueue_struct *fscrypt_read_workqueue;
 static DEFINE_MUTEX(fscrypt_init_mutex);
 
 static struct kmem_cache *fscrypt_ctx_cachep;
 struct kmem_cache *fscrypt_info_cachep;
 
+/*
+ * Per-CPU skcipher requests used to decrypt directly in the read completion
+ * path, where we may neither sleep nor allocate.  Only synchronous transforms
+ * whose request context fits in FS_INLINE_REQ_SIZE can use them.
+ */
+#define FS_INLINE_REQ_SIZE	(sizeof(struct skcipher_request) + 384)
+static void __percpu *fscrypt_inline_reqs;
+
+struct fscrypt_iv {
+	__le64 index;
+	u8 padding[FS_IV_SIZE - sizeof(__le64)];
+};
+
 void fscrypt_enqueue_decrypt_work(struct work_struct *work)
 {
 	queue_work(fscrypt_read_workqueue, work);
 }
 EXPORT_SYMBOL(fscrypt_enqueue_decrypt_work);
 
+static void fscrypt_free_shared_ctx(struct fscrypt_ctx *ctx)
+{
+	unsigned long flags;
+
+	if (ctx->flags & FS_CTX_REQUIRES_FREE_ENCRYPT_FL) {
+		kmem_cache_free(fscrypt_ctx_cachep, ctx);
+	} else {
+		spin_lock_irqsave(&fscrypt_ctx_lock, flags);
+		list_add(&ctx->free_list, &fscrypt_free_ctxs);
+		spin_unlock_irqrestore(&fscrypt_ctx_lock, flags);
+	}
+}
+
+/*
+ * Return whatever @pcp holds beyond @keep entries to the shared pools.
+ * Called with interrupts disabled on the owning CPU, or for a dead CPU.
+ */
+static void fscrypt_pcp_trim(struct fscrypt_pcp_cache *pcp, unsigned int keep)
+{
+	struct fscrypt_ctx *ctx;
+
+	while (pcp->nr_pages > keep)
+		mempool_free(pcp->pages[--pcp->nr_pages],
+			     fscrypt_bounce_page_pool);
+
+	while (pcp->nr_ctxs > keep) {
+		ctx = list_first_entry(&pcp->free_ctxs, struct fscrypt_ctx,
+				       free_list);
+		list_del(&ctx->free_list);
+		pcp->nr_ctxs--;
+		fscrypt_free_shared_ctx(ctx);
+	}
+}
+
+/*
+ * Resize @pcp from the number of bounce pages its CPU allocated during the
+ * last window.  A CPU that went idle for a full window drops to the minimum.
+ */
+static void fscrypt_pcp_account(struct fscrypt_pcp_cache *pcp)
+{
+	unsigned long now = jiffies;
+
+	if (time_after(now, pcp->window_start + FS_PCP_WINDOW)) {
+		if (time_after(now, pcp->window_start + 2 * FS_PCP_WINDOW))
+			pcp->window_allocs = 0;
+		pcp->high = clamp_t(unsigned int, pcp->window_allocs / 2,
+				    FS_PCP_CACHE_MIN, FS_PCP_CACHE_MAX);
+		pcp->window_allocs = 0;
+		pcp->window_start = now;
+		fscrypt_pcp_trim(pcp, pcp->high);
+	}
+	pcp->window_allocs++;
+}
+
+/*
+ * Only cache @page if the mempool reserve is full, i.e. if mempool_free()
+ * would have handed it back to the page allocator anyway.  Pages needed to
+ * refill the reserve must never sit in a per-CPU cache: writeback waiting in
+ * mempool_alloc() can only be woken by mempool_free().
+ */
+static void fscrypt_free_bounce_page(struct page *page)
+{
+	mempool_t *pool = fscrypt_bounce_page_pool;
+	struct fscrypt_pcp_cache *pcp;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(fscrypt_pcp);
+	if (pcp->nr_pages < pcp->high &&
+	    READ_ONCE(pool->curr_nr) >= pool->min_nr) {
+		pcp->pages[pcp->nr_pages++] = page;
+		page = NULL;
+	}
+	local_irq_restore(flags);
+
+	if (page)
+		mempool_free(page, fscrypt_bounce_page_pool);
+}
+
+/* Called on each CPU, with interrupts disabled, by on_each_cpu(). */
+static void fscrypt_pcp_drain_pages(void *unused)
+{
+	struct fscrypt_pcp_cache *pcp = this_cpu_ptr(fscrypt_pcp);
+
+	while (pcp->nr_pages)
+		mempool_free(pcp->pages[--pcp->nr_pages],
+			     fscrypt_bounce_page_pool);
+}
+
 /**
  * fscrypt_release_ctx() - Releases an encryption context
  * @ctx: The encryption context to release.
  *
- * If the encryption context was allocated from the pre-allocated pool, returns
- * it to that pool. Else, frees it.
+ * Caches the encryption context on the local CPU if there is room. Otherwise,
+ * if it was allocated from the pre-allocated pool, returns it to that pool.
+ * Else, frees it.
  *
  * If there's a bounce page in the context, this frees that.
  */
 void fscrypt_release_ctx(struct fscrypt_ctx *ctx)
 {
+	struct fscrypt_pcp_cache *pcp;
 	unsigned long flags;
 
 	if (ctx->flags & FS_CTX_HAS_BOUNCE_BUFFER_FL && ctx->w.bounce_page) {
-		mempool_free(ctx->w.bounce_page, fscrypt_bounce_page_pool);
+		fscrypt_free_bounce_page(ctx->w.bounce_page);
 		ctx->w.bounce_page = NULL;
 	}
 	ctx->w.control_page = NULL;
-	if (ctx->flags & FS_CTX_REQUIRES_FREE_ENCRYPT_FL) {
-		kmem_cache_free(fscrypt_ctx_cachep, ctx);
-	} else {
-		spin_lock_irqsave(&fscrypt_ctx_lock, flags);
-		list_add(&ctx->free_list, &fscrypt_free_ctxs);
-		spin_unlock_irqrestore(&fscrypt_ctx_lock, flags);
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(fscrypt_pcp);
+	if (pcp->nr_ctxs < pcp->high) {
+		list_add(&ctx->free_list, &pcp->free_ctxs);
+		pcp->nr_ctxs++;
+		ctx = NULL;
 	}
+	local_irq_restore(flags);
+
+	if (ctx)
+		fscrypt_free_shared_ctx(ctx);
 }
 EXPORT_SYMBOL(fscrypt_release_ctx);
 
@@ -99,6 +236,7 @@ struct fscrypt_ctx *fscrypt_get_ctx(const struct inode *inode, gfp_t gfp_flags)
 {
 	struct fscrypt_ctx *ctx = NULL;
 	struct fscrypt_info *ci = inode->i_crypt_info;
+	struct fscrypt_pcp_cache *pcp;
 	unsigned long flags;
 
 	if (ci == NULL)
@@ -108,40 +246,62 @@ struct fscrypt_ctx *fscrypt_get_ctx(const struct inode *inode, gfp_t gfp_flags)
 	 * We first try getting the ctx from a free list because in
 	 * the common case the ctx will have an allocated and
 	 * initialized crypto tfm, so it's probably a worthwhile
-	 * optimization. For the bounce page, we first try getting it
-	 * from the kernel allocator because that's just about as fast
-	 * as getting it from a list and because a cache of free pages
+	 * optimization.  The local CPU's list is tried before the
+	 * shared one to stay off fscrypt_ctx_lock.  For the bounce
+	 * page, we first try the local CPU's cache and then the
+	 * kernel allocator because that's just about as fast as
+	 * getting it from a list and because a cache of free pages
 	 * should generally be a "last resort" option for a filesystem
 	 * to be able to do its job.
 	 */
-	spin_lock_irqsave(&fscrypt_ctx_lock, flags);
-	ctx = list_first_entry_or_null(&fscrypt_free_ctxs,
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(fscrypt_pcp);
+	ctx = list_first_entry_or_null(&pcp->free_ctxs,
 					struct fscrypt_ctx, free_list);
-	if (ctx)
+	if (ctx) {
 		list_del(&ctx->free_list);
-	spin_unlock_irqrestore(&fscrypt_ctx_lock, flags);
+		pcp->nr_ctxs--;
+	}
+	local_irq_restore(flags);
+
+	if (!ctx) {
+		spin_lock_irqsave(&fscrypt_ctx_lock, flags);
+		ctx = list_first_entry_or_null(&fscrypt_free_ctxs,
+						struct fscrypt_ctx, free_list);
+		if (ctx)
+			list_del(&ctx->free_list);
+		spin_unlock_irqrestore(&fscrypt_ctx_lock, flags);
+	}
 	if (!ctx) {
 		ctx = kmem_cache_zalloc(fscrypt_ctx_cachep, gfp_flags);
 		if (!ctx)
 			return ERR_PTR(-ENOMEM);
 		ctx->flags |= FS_CTX_REQUIRES_FREE_ENCRYPT_FL;
-	} else {
-		ctx->flags &= ~FS_CTX_REQUIRES_FREE_ENCRYPT_FL;
 	}
 	ctx->flags &= ~FS_CTX_HAS_BOUNCE_BUFFER_FL;
 	return ctx;
 }
 EXPORT_SYMBOL(fscrypt_get_ctx);
 
+static void fscrypt_generate_iv(struct fscrypt_iv *iv, u64 lblk_num,
+				const struct fscrypt_info *ci)
+{
+	BUILD_BUG_ON(sizeof(*iv) != FS_IV_SIZE);
+	BUILD_BUG_ON(AES_BLOCK_SIZE != FS_IV_SIZE);
+	iv->index = cpu_to_le64(lblk_num);
+	memset(iv->padding, 0, sizeof(iv->padding));
+
+	if (ci->ci_essiv_tfm != NULL)
+		crypto_cipher_encrypt_one(ci->ci_essiv_tfm, (u8 *)iv,
+					  (u8 *)iv);
+}
+
 int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 			   u64 lblk_num, struct page *src_page,
 			   struct page *dest_page, unsigned int len,
 			   unsigned int offs, gfp_t gfp_flags)
 {
-	struct {
-		__le64 index;
-		u8 padding[FS_IV_SIZE - sizeof(__le64)];
-	} iv;
+	struct fscrypt_iv iv;
 	struct skcipher_request *req = NULL;
 	DECLARE_CRYPTO_WAIT(wait);
 	struct scatterlist dst, src;
@@ -151,15 +311,7 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 
 	BUG_ON(len == 0);
 
-	BUILD_BUG_ON(sizeof(iv) != FS_IV_SIZE);
-	BUILD_BUG_ON(AES_BLOCK_SIZE != FS_IV_SIZE);
-	iv.index = cpu_to_le64(lblk_num);
-	memset(iv.padding, 0, sizeof(iv.padding));
-
-	if (ci->ci_essiv_tfm != NULL) {
-		crypto_cipher_encrypt_one(ci->ci_essiv_tfm, (u8 *)&iv,
-					  (u8 *)&iv);
-	}
+	fscrypt_generate_iv(&iv, lblk_num, ci);
 
 	req = skcipher_request_alloc(tfm, gfp_flags);
 	if (!req)
@@ -189,10 +341,99 @@ int fscrypt_do_page_crypto(const struct inode *inode, fscrypt_direction_t rw,
 	return 0;
 }
 
+/**
+ * fscrypt_inline_decrypt_capable() - Can pages of @inode be decrypted inline?
+ * @inode: The inode whose contents key would be used
+ *
+ * Return: true if fscrypt_decrypt_page_inline() may be used for @inode, i.e.
+ * its contents transform is synchronous and a per-CPU request fits it.
+ */
+bool fscrypt_inline_decrypt_capable(const struct inode *inode)
+{
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	struct crypto_skcipher *tfm;
+
+	if (!fscrypt_inline_reqs || ci == NULL)
+		return false;
+
+	tfm = ci->ci_ctfm;
+	if (crypto_skcipher_tfm(tfm)->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC)
+		return false;
+
+	return sizeof(struct skcipher_request) +
+		crypto_skcipher_reqsize(tfm) <= FS_INLINE_REQ_SIZE;
+}
+
+/**
+ * fscrypt_decrypt_page_inline() - Decrypts a full page in-place, atomically
+ * @inode:     The corresponding inode for the page to decrypt.
+ * @page:      The locked page to decrypt.
+ * @lblk_num:  Logical block number.
+ *
+ * Like fscrypt_decrypt_page(), but never sleeps or allocates, so it can be
+ * called from a bio completion handler running in softirq context.  The
+ * caller must have checked fscrypt_inline_decrypt_capable() and must not
+ * be running with hard interrupts disabled.
+ *
+ * Return: Zero on success, non-zero otherwise.
+ */
+int fscrypt_decrypt_page_inline(const struct inode *inode, struct page *page,
+				u64 lblk_num)
+{
+	struct fscrypt_iv iv;
+	struct skcipher_request *req;
+	struct scatterlist sg;
+	struct fscrypt_info *ci = inode->i_crypt_info;
+	int res;
+
+	fscrypt_generate_iv(&iv, lblk_num, ci);
+
+	sg_init_table(&sg, 1);
+	sg_set_page(&sg, page, PAGE_SIZE, 0);
+
+	/* The request is shared with softirqs completing on this CPU */
+	local_bh_disable();
+	req = this_cpu_ptr(fscrypt_inline_reqs);
+	skcipher_request_set_tfm(req, ci->ci_ctfm);
+	skcipher_request_set_callback(req, 0, NULL, NULL);
+	skcipher_request_set_crypt(req, &sg, &sg, PAGE_SIZE, &iv);
+	res = crypto_skcipher_decrypt(req);
+	local_bh_enable();
+
+	if (res)
+		fscrypt_err(inode->i_sb,
+			    "decryption failed for inode %lu, block %llu: %d",
+			    inode->i_ino, lblk_num, res);
+	return res;
+}
+
 struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 				       gfp_t gfp_flags)
 {
-	ctx->w.bounce_page = mempool_alloc(fscrypt_bounce_page_pool, gfp_flags);
+	struct fscrypt_pcp_cache *pcp;
+	struct page *page = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pcp = this_cpu_ptr(fscrypt_pcp);
+	fscrypt_pcp_account(pcp);
+	if (pcp->nr_pages)
+		page = pcp->pages[--pcp->nr_pages];
+	local_irq_restore(flags);
+
+	/*
+	 * Before sleeping in mempool_alloc(), give back the pages cached on
+	 * every CPU, so that an empty reserve isn't waiting on idle CPUs.
+	 */
+	if (!page && gfpflags_allow_blocking(gfp_flags)) {
+		page = mempool_alloc(fscrypt_bounce_page_pool,
+				     gfp_flags & ~__GFP_DIRECT_RECLAIM);
+		if (!page)
+			on_each_cpu(fscrypt_pcp_drain_pages, NULL, 1);
+	}
+	if (!page)
+		page = mempool_alloc(fscrypt_bounce_page_pool, gfp_flags);
+	ctx->w.bounce_page = page;
 	if (ctx->w.bounce_page == NULL)
 		return ERR_PTR(-ENOMEM);
 	ctx->flags |= FS_CTX_HAS_BOUNCE_BUFFER_FL;
@@ -423,6 +664,93 @@ fail:
 	return res;
 }
 
+static int fscrypt_cpu_notify(struct notifier_block *self,
+			      unsigned long action, void *hcpu)
+{
+	unsigned long cpu = (unsigned long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		fscrypt_pcp_trim(per_cpu_ptr(fscrypt_pcp, cpu), 0);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block fscrypt_cpu_notifier = {
+	.notifier_call = fscrypt_cpu_notify,
+};
+
+static unsigned long fscrypt_pcp_count(struct shrinker *shrink,
+				       struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		struct fscrypt_pcp_cache *pcp = per_cpu_ptr(fscrypt_pcp, cpu);
+
+		count += READ_ONCE(pcp->nr_pages) + READ_ONCE(pcp->nr_ctxs);
+	}
+	return count;
+}
+
+/* Called on each CPU, with interrupts disabled, by on_each_cpu(). */
+static void fscrypt_pcp_drain(void *unused)
+{
+	struct fscrypt_pcp_cache *pcp = this_cpu_ptr(fscrypt_pcp);
+
+	fscrypt_pcp_trim(pcp, 0);
+	pcp->high = FS_PCP_CACHE_MIN;
+}
+
+static unsigned long fscrypt_pcp_scan(struct shrinker *shrink,
+				      struct shrink_control *sc)
+{
+	unsigned long count = fscrypt_pcp_count(shrink, sc);
+
+	if (count)
+		on_each_cpu(fscrypt_pcp_drain, NULL, 1);
+	return count;
+}
+
+static struct shrinker fscrypt_pcp_shrinker = {
+	.count_objects = fscrypt_pcp_count,
+	.scan_objects = fscrypt_pcp_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init fscrypt_pcp_init(void)
+{
+	int cpu;
+
+	fscrypt_pcp = alloc_percpu(struct fscrypt_pcp_cache);
+	if (!fscrypt_pcp)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct fscrypt_pcp_cache *pcp = per_cpu_ptr(fscrypt_pcp, cpu);
+
+		INIT_LIST_HEAD(&pcp->free_ctxs);
+		pcp->high = FS_PCP_CACHE_MIN;
+		pcp->window_start = jiffies;
+	}
+	if (register_shrinker(&fscrypt_pcp_shrinker)) {
+		free_percpu(fscrypt_pcp);
+		return -ENOMEM;
+	}
+	register_hotcpu_notifier(&fscrypt_cpu_notifier);
+	return 0;
+}
+
+static void __exit fscrypt_pcp_exit(void)
+{
+	int cpu;
+
+	unregister_hotcpu_notifier(&fscrypt_cpu_notifier);
+	unregister_shrinker(&fscrypt_pcp_shrinker);
+	for_each_possible_cpu(cpu)
+		fscrypt_pcp_trim(per_cpu_ptr(fscrypt_pcp, cpu), 0);
+	free_percpu(fscrypt_pcp);
+}
+
 void fscrypt_msg(struct super_block *sb, const char *level,
 		 const char *fmt, ...)
 {
@@ -471,8 +799,17 @@ static int __init fscrypt_init(void)
 	if (!fscrypt_info_cachep)
 		goto fail_free_ctx;
 
+	if (fscrypt_pcp_init())
+		goto fail_free_info;
+
+	/* Inline decryption is optional; just fall back if this fails. */
+	fscrypt_inline_reqs = __alloc_percpu(FS_INLINE_REQ_SIZE,
+					     CRYPTO_MINALIGN);
+
 	return 0;
 
+fail_free_info:
+	kmem_cache_destroy(fscrypt_info_cachep);
 fail_free_ctx:
 	kmem_cache_destroy(fscrypt_ctx_cachep);
 fail_free_queue:
@@ -487,12 +824,14 @@ module_init(fscrypt_init)
  */
 static void __exit fscrypt_exit(void)
 {
+	fscrypt_pcp_exit();
 	fscrypt_destroy();
 
 	if (fscrypt_read_workqueue)
 		destroy_workqueue(fscrypt_read_workqueue);
 	kmem_cache_destroy(fscrypt_ctx_cachep);
 	kmem_cache_destroy(fscrypt_info_cachep);
+	free_percpu(fscrypt_inline_reqs);
 
 	fscrypt_essiv_cleanup();
 }
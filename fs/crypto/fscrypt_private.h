@@ -111,6 +111,9 @@ extern int fscrypt_do_page_crypto(const struct inode *inode,
 				  gfp_t gfp_flags);
 extern struct page *fscrypt_alloc_bounce_page(struct fscrypt_ctx *ctx,
 					      gfp_t gfp_flags);
+extern bool fscrypt_inline_decrypt_capable(const struct inode *inode);
+extern int fscrypt_decrypt_page_inline(const struct inode *inode,
+				       struct page *page, u64 lblk_num);
 extern const struct dentry_operations fscrypt_d_ops;
 
 extern void __printf(3, 4) __cold
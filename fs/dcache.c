@@ -39,6 +39,8 @@
 #include <linux/ratelimit.h>
 #include <linux/list_lru.h>
 #include <linux/kasan.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include "internal.h"
 #include "mount.h"
@@ -123,6 +125,14 @@ struct dentry_stat_t dentry_stat = {
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
 
+/*
+ * Maximum number of unused negative dentries per superblock, 0 for no
+ * limit.  Beyond it the oldest ones are pruned from a work item.
+ */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
+static void prune_negative_dentries(struct work_struct *work);
+static DECLARE_WORK(negative_dentry_work, prune_negative_dentries);
+
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
 /*
@@ -306,21 +316,29 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 					  unsigned type_flags)
 {
 	unsigned flags;
+	bool negative = d_is_negative(dentry);
 
 	dentry->d_inode = inode;
 	flags = READ_ONCE(dentry->d_flags);
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	flags |= type_flags;
 	WRITE_ONCE(dentry->d_flags, flags);
+
+	if ((flags & DCACHE_LRU_LIST) && negative && !d_is_negative(dentry))
+		percpu_counter_dec(&dentry->d_sb->s_nr_negative_dentry);
 }
 
 static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
+	bool negative = d_is_negative(dentry);
 
 	flags &= ~(DCACHE_ENTRY_TYPE | DCACHE_FALLTHRU);
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
+
+	if ((flags & DCACHE_LRU_LIST) && !negative)
+		percpu_counter_inc(&dentry->d_sb->s_nr_negative_dentry);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -413,17 +431,40 @@ static void dentry_unlink_inode(struct dentry * dentry)
  * on the shrink list (ie not on the superblock LRU list).
  *
  * The per-cpu "nr_dentry_unused" counters are updated with
- * the DCACHE_LRU_LIST bit.
+ * the DCACHE_LRU_LIST bit, and so is the per-superblock count
+ * of negative dentries.
  *
  * These helper functions make sure we always follow the
  * rules. d_lock must be held by the caller.
  */
 #define D_FLAG_VERIFY(dentry,x) WARN_ON_ONCE(((dentry)->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) != (x))
+static inline void d_negative_inc(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+	unsigned long limit;
+
+	if (!d_is_negative(dentry))
+		return;
+	limit = READ_ONCE(sysctl_negative_dentry_limit);
+	percpu_counter_inc(&sb->s_nr_negative_dentry);
+	if (limit &&
+	    percpu_counter_read_positive(&sb->s_nr_negative_dentry) > limit &&
+	    !work_pending(&negative_dentry_work))
+		schedule_work(&negative_dentry_work);
+}
+
+static inline void d_negative_dec(struct dentry *dentry)
+{
+	if (d_is_negative(dentry))
+		percpu_counter_dec(&dentry->d_sb->s_nr_negative_dentry);
+}
+
 static void d_lru_add(struct dentry *dentry)
 {
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	d_negative_inc(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -432,6 +473,7 @@ static void d_lru_del(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	d_negative_dec(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -441,6 +483,7 @@ static void d_shrink_del(struct dentry *dentry)
 	list_del_init(&dentry->d_lru);
 	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
 	this_cpu_dec(nr_dentry_unused);
+	d_negative_dec(dentry);
 }
 
 static void d_shrink_add(struct dentry *dentry, struct list_head *list)
@@ -449,6 +492,7 @@ static void d_shrink_add(struct dentry *dentry, struct list_head *list)
 	list_add(&dentry->d_lru, list);
 	dentry->d_flags |= DCACHE_SHRINK_LIST | DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
+	d_negative_inc(dentry);
 }
 
 /*
@@ -462,6 +506,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
+	d_negative_dec(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -1150,6 +1195,110 @@ static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 }
 
 
+static enum lru_status dentry_lru_isolate_negative(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	/*
+	 * Positive and busy dentries are left to the regular shrinker.  Move
+	 * them out of the way, or the next walk would start on them again.
+	 */
+	if (!d_is_negative(dentry) || dentry->d_lockref.count) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	if (dentry->d_flags & DCACHE_REFERENCED) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Bring the negative dentries of @sb back under sysctl_negative_dentry_limit,
+ * with some slack so that we are not woken up again by the next few misses.
+ * At most one pass is made over the LRU, in batches.
+ */
+static void prune_negative_dentries_sb(struct super_block *sb, void *unused)
+{
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+	unsigned long budget;
+	long excess;
+
+	if (!limit)
+		return;
+	limit -= limit >> 3;
+
+	budget = list_lru_count(&sb->s_dentry_lru);
+	while (budget &&
+	       (excess = percpu_counter_sum(&sb->s_nr_negative_dentry) -
+			 (long)limit) > 0) {
+		LIST_HEAD(dispose);
+		unsigned long nr = min_t(unsigned long, budget,
+					 min(2 * excess, 1024L));
+
+		budget -= nr;
+		list_lru_walk(&sb->s_dentry_lru, dentry_lru_isolate_negative,
+			      &dispose, nr);
+		shrink_dentry_list(&dispose);
+		cond_resched();
+	}
+}
+
+static void prune_negative_dentries(struct work_struct *work)
+{
+	iterate_supers(prune_negative_dentries_sb, NULL);
+}
+
+#ifdef CONFIG_PROC_FS
+static void dentry_sb_stats_show_sb(struct super_block *sb, void *arg)
+{
+	struct seq_file *m = arg;
+
+	seq_printf(m, "%s\t%s\t%lld\t%lld\t%lld\n", sb->s_type->name, sb->s_id,
+		   percpu_counter_sum_positive(&sb->s_nr_negative_dentry),
+		   percpu_counter_sum_positive(&sb->s_rcu_walk_fallbacks),
+		   percpu_counter_sum_positive(&sb->s_rcu_walk_revalidate));
+}
+
+static int dentry_sb_stats_show(struct seq_file *m, void *v)
+{
+	seq_puts(m, "type\tdev\tnegative\trcu_fallbacks\trcu_revalidate\n");
+	iterate_supers(dentry_sb_stats_show_sb, m);
+	return 0;
+}
+
+static int dentry_sb_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dentry_sb_stats_show, NULL);
+}
+
+static const struct file_operations dentry_sb_stats_fops = {
+	.open		= dentry_sb_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proc_dentry_sb_stats_init(void)
+{
+	proc_create("fs/dentry_sb_stats", 0444, NULL, &dentry_sb_stats_fops);
+	return 0;
+}
+fs_initcall(proc_dentry_sb_stats_init);
+#endif
+
 /**
  * shrink_dcache_sb - shrink dcache for a superblock
  * @sb: superblock
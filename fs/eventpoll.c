@@ -43,6 +43,8 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 
 /*
  * LOCKING:
@@ -171,8 +173,16 @@ struct epitem {
 
 	/* The structure that describe the interested events and the source fd */
 	struct epoll_event event;
+
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	/* Links the item on a per-CPU ready list while EPI_PCP_QUEUED is set */
+	struct llist_node pcp_llink;
+	unsigned long pcp_flags;
+#endif
 };
 
+#define EPI_PCP_QUEUED	0
+
 /*
  * This structure is stored inside the "private_data" member of the file
  * structure and represents the main data structure for the eventpoll
@@ -219,8 +229,24 @@ struct eventpoll {
 
 	/* used to optimize loop detection check */
 	u64 gen;
+
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	/* Items made ready without ->lock, merged into rdllist under it */
+	struct llist_head __percpu *pcp_rdllist;
+#endif
 };
 
+#ifdef CONFIG_EPOLL_PERCPU_READY
+/* ->wq is also woken without ->lock, so it is protected by its own lock */
+#define ep_wq_add(ep, wait)	add_wait_queue_exclusive(&(ep)->wq, wait)
+#define ep_wq_remove(ep, wait)	remove_wait_queue(&(ep)->wq, wait)
+#define ep_wq_wake(ep)		wake_up(&(ep)->wq)
+#else
+#define ep_wq_add(ep, wait)	__add_wait_queue_exclusive(&(ep)->wq, wait)
+#define ep_wq_remove(ep, wait)	__remove_wait_queue(&(ep)->wq, wait)
+#define ep_wq_wake(ep)		wake_up_locked(&(ep)->wq)
+#endif
+
 /* Wait structure used by the poll hooks */
 struct eppoll_entry {
 	/* List header used to link this structure to the "struct epitem" */
@@ -369,6 +395,23 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
 	spin_lock_init(&ncalls->lock);
 }
 
+#ifdef CONFIG_EPOLL_PERCPU_READY
+static bool ep_pcp_pending(struct eventpoll *ep)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (!llist_empty(per_cpu_ptr(ep->pcp_rdllist, cpu)))
+			return true;
+	return false;
+}
+#else
+static inline bool ep_pcp_pending(struct eventpoll *ep)
+{
+	return false;
+}
+#endif
+
 /**
  * ep_events_available - Checks if ready events might be available.
  *
@@ -379,7 +422,8 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR ||
+		ep_pcp_pending(ep);
 }
 
 /**
@@ -584,6 +628,61 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+#ifdef CONFIG_EPOLL_PERCPU_READY
+/*
+ * Move the items queued on the per-CPU lists by ep_pcp_queue() to
+ * ->rdllist. Must be called with ->lock and ->mtx held, so that it never
+ * runs while ep_scan_ready_list() works on ->rdllist without ->lock.
+ */
+static void ep_pcp_merge(struct eventpoll *ep)
+{
+	struct llist_node *node, *next;
+	struct epitem *epi;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		node = llist_del_all(per_cpu_ptr(ep->pcp_rdllist, cpu));
+		for (node = llist_reverse_order(node); node; node = next) {
+			/* The item can be queued again once the bit is clear */
+			next = node->next;
+			epi = llist_entry(node, struct epitem, pcp_llink);
+			clear_bit_unlock(EPI_PCP_QUEUED, &epi->pcp_flags);
+			if (!ep_is_linked(&epi->rdllink))
+				list_add_tail(&epi->rdllink, &ep->rdllist);
+		}
+	}
+}
+
+/*
+ * Lockless counterpart of the ->rdllist append in ep_poll_callback().
+ * Only the item that makes a per-CPU list non-empty wakes the waiters,
+ * the ones queued behind it are collected by the same wakeup.
+ * Returns whether ->poll_wait needs a wakeup.
+ */
+static int ep_pcp_queue(struct eventpoll *ep, struct epitem *epi, void *key)
+{
+	__u32 events = READ_ONCE(epi->event.events);
+
+	if (!(events & ~EP_PRIVATE_BITS))
+		return 0;
+	if (key && !((unsigned long) key & events))
+		return 0;
+	if (test_and_set_bit_lock(EPI_PCP_QUEUED, &epi->pcp_flags))
+		return 0;
+	if (!llist_add(&epi->pcp_llink, raw_cpu_ptr(ep->pcp_rdllist)))
+		return 0;
+
+	/* llist_add() orders the queueing before the waitqueue checks */
+	if (waitqueue_active(&ep->wq))
+		ep_wq_wake(ep);
+	return waitqueue_active(&ep->poll_wait);
+}
+#else
+static inline void ep_pcp_merge(struct eventpoll *ep)
+{
+}
+#endif
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -624,6 +723,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_pcp_merge(ep);
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -671,7 +771,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 		 * the ->poll() wait list (delayed after we release the lock).
 		 */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			ep_wq_wake(ep);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -720,6 +820,11 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 	rb_erase(&epi->rbn, &ep->rbr);
 
 	spin_lock_irqsave(&ep->lock, flags);
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	/* No callback can queue it anymore, get it off any per-CPU list */
+	if (test_bit(EPI_PCP_QUEUED, &epi->pcp_flags))
+		ep_pcp_merge(ep);
+#endif
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -788,6 +893,9 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	free_percpu(ep->pcp_rdllist);
+#endif
 	kfree(ep);
 }
 
@@ -951,6 +1059,13 @@ static int ep_alloc(struct eventpoll **pep)
 	ep = kzalloc(sizeof(*ep), GFP_KERNEL);
 	if (unlikely(!ep))
 		goto free_uid;
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	ep->pcp_rdllist = alloc_percpu(struct llist_head);
+	if (unlikely(!ep->pcp_rdllist)) {
+		kfree(ep);
+		goto free_uid;
+	}
+#endif
 
 	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
@@ -1011,6 +1126,13 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	if (!ep_has_wakeup_source(epi)) {
+		pwake = ep_pcp_queue(ep, epi, key);
+		goto out_wake;
+	}
+#endif
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	/*
@@ -1064,13 +1186,16 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * wait list.
 	 */
 	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+		ep_wq_wake(ep);
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
 out_unlock:
 	spin_unlock_irqrestore(&ep->lock, flags);
 
+#ifdef CONFIG_EPOLL_PERCPU_READY
+out_wake:
+#endif
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
@@ -1300,6 +1425,9 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	epi->event = *event;
 	epi->nwait = 0;
 	epi->next = EP_UNACTIVE_PTR;
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	epi->pcp_flags = 0;
+#endif
 	if (epi->event.events & EPOLLWAKEUP) {
 		error = ep_create_wakeup_source(epi);
 		if (error)
@@ -1356,7 +1484,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 
 		/* Notify waiting tasks that events are available */
 		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+			ep_wq_wake(ep);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -1387,6 +1515,10 @@ error_remove_epi:
 	 * And ep_insert() is called with "mtx" held.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+#ifdef CONFIG_EPOLL_PERCPU_READY
+	if (test_bit(EPI_PCP_QUEUED, &epi->pcp_flags))
+		ep_pcp_merge(ep);
+#endif
 	if (ep_is_linked(&epi->rdllink))
 		list_del_init(&epi->rdllink);
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -1463,7 +1595,7 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 
 			/* Notify waiting tasks that events are available */
 			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
+				ep_wq_wake(ep);
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
@@ -1631,7 +1763,7 @@ fetch_events:
 		 * ep_poll_callback() when events will become available.
 		 */
 		init_waitqueue_entry(&wait, current);
-		__add_wait_queue_exclusive(&ep->wq, &wait);
+		ep_wq_add(ep, &wait);
 
 		for (;;) {
 			/*
@@ -1655,7 +1787,7 @@ fetch_events:
 			spin_lock_irqsave(&ep->lock, flags);
 		}
 
-		__remove_wait_queue(&ep->wq, &wait);
+		ep_wq_remove(ep, &wait);
 		__set_current_state(TASK_RUNNING);
 	}
 check_events:
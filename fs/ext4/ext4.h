@@ -964,6 +964,8 @@ struct ext4_inode_info {
 	/* mballoc */
 	struct list_head i_prealloc_list;
 	spinlock_t i_prealloc_lock;
+	unsigned long i_mb_append_stamp;	/* last normalized append */
+	unsigned int i_mb_append_shift;	/* adaptive prealloc scale */
 
 	/* extents status tree */
 	struct ext4_es_tree i_es_tree;
@@ -1022,6 +1024,12 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/*
+	 * Last transaction that changed the inode in a way a fast commit
+	 * can't record.
+	 */
+	tid_t i_fc_ineligible_tid;
+
 #ifdef CONFIG_QUOTA
 	struct dquot *i_dquot[MAXQUOTAS];
 #endif
@@ -1082,6 +1090,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_JOURNAL_FAST_COMMIT	0x2000000 /* Fast commit on fsync */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1393,6 +1402,8 @@ struct ext4_sb_info {
 	unsigned int s_mb_stats;
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
+	unsigned int s_mb_adaptive_prealloc;
+	unsigned int s_mb_optimize_scan;
 	unsigned int s_max_dir_size_kb;
 	/* where last allocation was done - for stream allocation */
 	unsigned long s_mb_last_group;
@@ -1417,6 +1428,10 @@ struct ext4_sb_info {
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
 
+	/* groups with loaded buddies, by order of their largest free extent */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
+
 	/* for write statistics */
 	unsigned long s_sectors_written_start;
 	u64 s_kbytes_written;
@@ -1889,6 +1904,11 @@ static inline bool ext4_has_incompat_features(struct super_block *sb)
 #define EXT4_DEF_MIN_BATCH_TIME	0
 #define EXT4_DEF_MAX_BATCH_TIME	15000 /* 15ms */
 
+/*
+ * Size of the fast commit area reserved in the journal, at most 1/32 of it
+ */
+#define EXT4_FC_AREA_BLOCKS	256
+
 /*
  * Default reserved inode count
  */
@@ -2460,6 +2480,10 @@ extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
+/* fast_commit.c */
+extern int ext4_fc_commit(struct inode *inode, tid_t commit_tid);
+extern int ext4_fc_replay(journal_t *journal, void *data, unsigned int len);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -2513,6 +2537,7 @@ extern int ext4_group_add_blocks(handle_t *handle, struct super_block *sb,
 extern int ext4_trim_fs(struct super_block *, struct fstrim_range *,
 				unsigned long blkdev_flags);
 extern ssize_t ext4_mb_freefrag_show(struct ext4_sb_info *sbi, char *buf);
+extern void ext4_mb_set_optimize_scan(struct super_block *sb, unsigned int on);
 extern void ext4_process_freed_data(struct super_block *sb, tid_t commit_tid);
 
 /* inode.c */
@@ -2962,6 +2987,8 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
+	struct          list_head bb_largest_free_order_node;
 	struct          list_head bb_prealloc_list;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
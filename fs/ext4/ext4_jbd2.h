@@ -379,6 +379,21 @@ static inline void ext4_update_inode_fsync_trans(handle_t *handle,
 	}
 }
 
+/*
+ * @handle changes @inode in a way that a fast commit can't record, so an
+ * fsync must wait for its transaction to commit.  Call before the change.
+ */
+static inline void ext4_fc_mark_ineligible(handle_t *handle,
+					   struct inode *inode)
+{
+	if (ext4_handle_valid(handle)) {
+		WRITE_ONCE(EXT4_I(inode)->i_fc_ineligible_tid,
+			   handle->h_transaction->t_tid);
+		/* Pairs with smp_mb() in ext4_fc_commit() */
+		smp_mb();
+	}
+}
+
 /* super.c */
 int ext4_force_commit(struct super_block *sb);
 
@@ -2892,6 +2892,7 @@ int ext4_ext_remove_space(struct inode *inode, ext4_lblk_t start,
 	handle = ext4_journal_start(inode, EXT4_HT_TRUNCATE, depth + 1);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
+	ext4_fc_mark_ineligible(handle, inode);
 
 again:
 	trace_ext4_ext_remove_space(inode, start, end, depth);
@@ -5641,6 +5642,7 @@ int ext4_collapse_range(struct inode *inode, loff_t offset, loff_t len)
 		ret = PTR_ERR(handle);
 		goto out_mmap;
 	}
+	ext4_fc_mark_ineligible(handle, inode);
 
 	down_write(&EXT4_I(inode)->i_data_sem);
 	ext4_discard_preallocations(inode);
@@ -5780,6 +5782,7 @@ int ext4_insert_range(struct inode *inode, loff_t offset, loff_t len)
 		ret = PTR_ERR(handle);
 		goto out_mmap;
 	}
+	ext4_fc_mark_ineligible(handle, inode);
 
 	/* Expand file to avoid data loss if there is error while shifting */
 	inode->i_size += len;
@@ -0,0 +1,134 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ *  Fast commits of fsynced inodes.
+ *
+ * With the fast_commit mount option, fsync of a regular file whose only
+ * changes in the running transaction are to the inode itself (times, mode,
+ * flags, size within the allocated blocks, ...) writes a copy of the
+ * on-disk inode to the jbd2 fast commit area instead of committing the
+ * whole transaction.  If that transaction does not make it to disk, journal
+ * recovery copies the inode back into the inode table.
+ *
+ * Every change which also touches other metadata - block allocation and
+ * extent changes, truncate, link count and namespace changes, xattrs, the
+ * orphan list, quota transfers - marks the inode ineligible for the running
+ * transaction with ext4_fc_mark_ineligible(), and fsync waits for the full
+ * commit as before.
+ */
+
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+
+/* Payload of a fast commit block: an on-disk inode */
+struct ext4_fc_inode {
+	__le32	fc_ino;
+	__le16	fc_inode_size;
+	__le16	fc_reserved;
+	__u8	fc_raw_inode[0];
+};
+
+static bool ext4_fc_ineligible(struct inode *inode, tid_t commit_tid)
+{
+	return tid_geq(READ_ONCE(EXT4_I(inode)->i_fc_ineligible_tid),
+		       commit_tid);
+}
+
+/*
+ * Make the metadata of @inode in transaction @commit_tid durable with a
+ * fast commit.  Returns 0 if it is, an error if the caller has to wait for
+ * the transaction to commit instead.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t commit_tid)
+{
+	struct super_block *sb = inode->i_sb;
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	unsigned int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_fc_inode *fc;
+	struct ext4_iloc iloc;
+	struct buffer_head *bh;
+	int err;
+
+	if (!S_ISREG(inode->i_mode) || ext4_has_inline_data(inode) ||
+	    ext4_fc_ineligible(inode, commit_tid) ||
+	    sizeof(*fc) + inode_size > jbd2_fc_payload_size(journal))
+		return -EINVAL;
+
+	err = ext4_get_inode_loc(inode, &iloc);
+	if (err)
+		return err;
+	err = jbd2_fc_begin_commit(journal, commit_tid, &bh);
+	if (err)
+		goto out;
+
+	fc = jbd2_fc_payload(bh);
+	fc->fc_ino = cpu_to_le32(inode->i_ino);
+	fc->fc_inode_size = cpu_to_le16(inode_size);
+	spin_lock(&ei->i_raw_lock);
+	memcpy(fc->fc_raw_inode, ext4_raw_inode(&iloc), inode_size);
+	spin_unlock(&ei->i_raw_lock);
+
+	/*
+	 * Pairs with the barrier in ext4_fc_mark_ineligible(): if the copy
+	 * contains any part of an ineligible change, we see the mark.
+	 */
+	smp_mb();
+	if (ext4_fc_ineligible(inode, commit_tid)) {
+		jbd2_fc_end_commit(journal, bh, 0);
+		err = -EINVAL;
+		goto out;
+	}
+	err = jbd2_fc_end_commit(journal, bh, sizeof(*fc) + inode_size);
+out:
+	brelse(iloc.bh);
+	return err;
+}
+
+/*
+ * Journal recovery callback: write the inode in a fast commit block back
+ * to the inode table.  The log has been replayed already, so the block
+ * holds the state of the last committed transaction.
+ */
+int ext4_fc_replay(journal_t *journal, void *data, unsigned int len)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_inode *fc = data;
+	unsigned int inode_size = EXT4_INODE_SIZE(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	unsigned long ino, offset;
+	ext4_fsblk_t block;
+
+	if (len < sizeof(*fc) ||
+	    le16_to_cpu(fc->fc_inode_size) != inode_size ||
+	    sizeof(*fc) + inode_size > len)
+		return -EFSCORRUPTED;
+	ino = le32_to_cpu(fc->fc_ino);
+	if (!ext4_valid_inum(sb, ino))
+		return -EFSCORRUPTED;
+
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return -EFSCORRUPTED;
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * inode_size;
+	block = ext4_inode_table(sb, gdp) +
+		(offset >> EXT4_BLOCK_SIZE_BITS(sb));
+	offset &= sb->s_blocksize - 1;
+
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+	lock_buffer(bh);
+	memcpy(bh->b_data + offset, fc->fc_raw_inode, inode_size);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+
+	jbd_debug(1, "EXT4: fast commit of inode %lu replayed\n", ino);
+	return 0;
+}
@@ -177,6 +177,8 @@ int ext4_truncate_restart_trans(handle_t *handle, struct inode *inode,
 	ret = ext4_journal_restart(handle, nblocks);
 	down_write(&EXT4_I(inode)->i_data_sem);
 	ext4_discard_preallocations(inode);
+	/* The rest of the truncate goes into the new transaction */
+	ext4_fc_mark_ineligible(handle, inode);
 
 	return ret;
 }
@@ -601,6 +603,9 @@ found:
 	 */
 	map->m_flags &= ~EXT4_MAP_FLAGS;
 
+	/* Allocation changes bitmaps and maybe extent blocks */
+	ext4_fc_mark_ineligible(handle, inode);
+
 	/*
 	 * New blocks allocate and/or writing to unwritten extent
 	 * will possibly result in updating i_data, so we take
@@ -3841,6 +3846,7 @@ int ext4_punch_hole(struct inode *inode, loff_t offset, loff_t length)
 		ext4_std_error(sb, ret);
 		goto out_dio;
 	}
+	ext4_fc_mark_ineligible(handle, inode);
 
 	ret = ext4_zero_partial_blocks(handle, inode, offset,
 				       length);
@@ -3991,6 +3997,7 @@ void ext4_truncate(struct inode *inode)
 		ext4_std_error(inode->i_sb, PTR_ERR(handle));
 		return;
 	}
+	ext4_fc_mark_ineligible(handle, inode);
 
 	if (inode->i_size & (inode->i_sb->s_blocksize - 1))
 		ext4_block_truncate_page(handle, mapping, inode->i_size);
@@ -4468,6 +4475,8 @@ struct inode *__ext4_iget(struct super_block *sb, unsigned long ino,
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		/* Likewise whether it changed in ways a fast commit misses */
+		ei->i_fc_ineligible_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
@@ -4751,8 +4760,11 @@ static int ext4_do_update_inode(handle_t *handle,
 	if (ei->i_disksize > 0x7fffffffULL) {
 		if (!ext4_has_feature_large_file(sb) ||
 				EXT4_SB(sb)->s_es->s_rev_level ==
-		    cpu_to_le32(EXT4_GOOD_OLD_REV))
+		    cpu_to_le32(EXT4_GOOD_OLD_REV)) {
+			/* The superblock changes too */
+			ext4_fc_mark_ineligible(handle, inode);
 			set_large_file = 1;
+		}
 	}
 	raw_inode->i_generation = cpu_to_le32(inode->i_generation);
 	if (S_ISCHR(inode->i_mode) || S_ISBLK(inode->i_mode)) {
@@ -4983,6 +4995,7 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 			error = PTR_ERR(handle);
 			goto err_out;
 		}
+		ext4_fc_mark_ineligible(handle, inode);
 		error = dquot_transfer(inode, attr);
 		if (error) {
 			ext4_journal_stop(handle);
@@ -5374,6 +5387,8 @@ int ext4_mark_inode_dirty(handle_t *handle, struct inode *inode)
 		 */
 		if ((jbd2_journal_extend(handle,
 			     EXT4_DATA_TRANS_BLOCKS(inode->i_sb))) == 0) {
+			/* May move xattrs out to an EA block */
+			ext4_fc_mark_ineligible(handle, inode);
 			ret = ext4_expand_extra_isize(inode,
 						      sbi->s_want_extra_isize,
 						      iloc, handle);
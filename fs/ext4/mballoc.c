@@ -146,6 +146,12 @@ MODULE_PARM_DESC(mballoc_debug, "Debugging level for ext4's mballoc");
  * the smallest multiple of the stripe value (sbi->s_stripe) which is
  * greater than the default mb_group_prealloc.
  *
+ * With /sys/fs/ext4/<partition>/mb_adaptive_prealloc set, a locality group
+ * that runs dry again shortly after its last refill gets a larger one, up
+ * to eight times mb_group_prealloc, and an inode appending at a high rate
+ * has its file size predicted further ahead.  Both scale back down once
+ * the stream slows down.
+ *
  * The regular allocator (using the buddy cache) supports a few tunables.
  *
  * /sys/fs/ext4/<partition>/mb_min_to_scan
@@ -168,6 +174,10 @@ MODULE_PARM_DESC(mballoc_debug, "Debugging level for ext4's mballoc");
  * can be used for allocation. ext4_mb_good_group explains how the groups are
  * checked.
  *
+ * With /sys/fs/ext4/<partition>/mb_optimize_scan set, power-of-2 requests
+ * first look at the groups kept on per-order lists by the order of their
+ * largest free extent, and fall back to the scan above if none fits.
+ *
  * Both the prealloc space are getting populated as above. So for the first
  * request we will hit the buddy cache which will result in this prealloc
  * space getting filled. The prealloc space is then later used for the
@@ -703,18 +713,85 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	int i;
 	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
+	int old = grp->bb_largest_free_order;
+	int order = -1; /* uninit */
+	bool listed = !list_empty(&grp->bb_largest_free_order_node);
+	bool want;
 
 	bits = sb->s_blocksize_bits + 1;
 	for (i = bits; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			order = i;
 			break;
 		}
 	}
+	grp->bb_largest_free_order = order;
+
+	/*
+	 * Keep the group on the list of its new order, but only while
+	 * mb_optimize_scan is on: the lists are shared by the whole fs.
+	 */
+	want = READ_ONCE(sbi->s_mb_optimize_scan) && order >= 0;
+	if (order == old && listed == want)
+		return;
+
+	if (listed) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	if (want) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[order]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+	}
+}
+
+/*
+ * Turn mb_optimize_scan on or off.  The largest free order lists are only
+ * maintained while it is on, so they are filled from the groups whose buddy
+ * is loaded when it gets turned on, and emptied when it gets turned off.
+ */
+void ext4_mb_set_optimize_scan(struct super_block *sb, unsigned int on)
+{
+	static DEFINE_MUTEX(ext4_mb_optimize_scan_mutex);
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	ext4_group_t group;
+
+	on = !!on;
+	mutex_lock(&ext4_mb_optimize_scan_mutex);
+	if (sbi->s_mb_optimize_scan == on)
+		goto out;
+	WRITE_ONCE(sbi->s_mb_optimize_scan, on);
+
+	for (group = 0; group < ngroups; group++) {
+		struct ext4_group_info *grp = ext4_get_group_info(sb, group);
+		int order;
+
+		ext4_lock_group(sb, group);
+		order = grp->bb_largest_free_order;
+		if (on && order >= 0 && !EXT4_MB_GRP_NEED_INIT(grp) &&
+		    list_empty(&grp->bb_largest_free_order_node)) {
+			write_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+			list_add_tail(&grp->bb_largest_free_order_node,
+				      &sbi->s_mb_largest_free_orders[order]);
+			write_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+		} else if (!on &&
+			   !list_empty(&grp->bb_largest_free_order_node)) {
+			write_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+			list_del_init(&grp->bb_largest_free_order_node);
+			write_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+		}
+		ext4_unlock_group(sb, group);
+		cond_resched();
+	}
+out:
+	mutex_unlock(&ext4_mb_optimize_scan_mutex);
 }
 
 static noinline_for_stack
@@ -2121,6 +2198,81 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Pick a group for a criteria 0 request from the lists of groups keyed by
+ * the order of their largest free extent, smallest fitting order first,
+ * instead of probing every group from the goal onwards.  Only groups whose
+ * buddy has already been generated are on the lists.
+ */
+static bool ext4_mb_choose_group_by_order(struct ext4_allocation_context *ac,
+					  ext4_group_t ngroups,
+					  ext4_group_t skip,
+					  ext4_group_t *group)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
+	struct ext4_group_info *grp;
+	int order;
+
+	for (order = ac->ac_2order;
+	     order <= ac->ac_sb->s_blocksize_bits + 1; order++) {
+		if (list_empty_careful(&sbi->s_mb_largest_free_orders[order]))
+			continue;
+		read_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_for_each_entry(grp, &sbi->s_mb_largest_free_orders[order],
+				    bb_largest_free_order_node) {
+			if (grp->bb_group >= ngroups || grp->bb_group == skip)
+				continue;
+			/* good_group must not initialize a group under us */
+			if (EXT4_MB_GRP_NEED_INIT(grp))
+				continue;
+			if (ext4_mb_good_group(ac, grp->bb_group, 0) <= 0)
+				continue;
+			*group = grp->bb_group;
+			read_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+			return true;
+		}
+		read_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+	}
+	return false;
+}
+
+#define MB_OPTIMIZE_SCAN_TRIES	4
+
+/*
+ * Criteria 0 scan driven by the largest free order lists.  If it does not
+ * find anything the regular allocator goes on with its linear scan, which
+ * also covers groups whose buddy has not been loaded yet.
+ */
+static noinline_for_stack int
+ext4_mb_scan_by_order(struct ext4_allocation_context *ac, ext4_group_t ngroups)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_buddy e4b;
+	ext4_group_t group, prev = ngroups;
+	int tries, err;
+
+	ac->ac_criteria = 0;
+	for (tries = 0; tries < MB_OPTIMIZE_SCAN_TRIES &&
+	     ac->ac_status == AC_STATUS_CONTINUE; tries++) {
+		if (!ext4_mb_choose_group_by_order(ac, ngroups, prev, &group))
+			break;
+		prev = group;
+
+		err = ext4_mb_load_buddy(sb, group, &e4b);
+		if (err)
+			return err;
+
+		ext4_lock_group(sb, group);
+		if (ext4_mb_good_group(ac, group, 0) > 0) {
+			ac->ac_groups_scanned++;
+			ext4_mb_simple_scan_group(ac, &e4b);
+		}
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(&e4b);
+	}
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
@@ -2182,6 +2334,11 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 
 	/* Let's just scan groups to find more-less suitable blocks */
 	cr = ac->ac_2order ? 0 : 1;
+	if (cr == 0 && sbi->s_mb_optimize_scan) {
+		err = ext4_mb_scan_by_order(ac, ngroups);
+		if (err)
+			goto out;
+	}
 	/*
 	 * cr == 0 try to get exact allocation,
 	 * cr == 3  try to get anything
@@ -2535,6 +2692,8 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2716,6 +2875,24 @@ int ext4_mb_init(struct super_block *sb)
 		i++;
 	} while (i <= sb->s_blocksize_bits + 1);
 
+	sbi->s_mb_largest_free_orders =
+		kmalloc_array(sb->s_blocksize_bits + 2,
+			      sizeof(*sbi->s_mb_largest_free_orders),
+			      GFP_KERNEL);
+	sbi->s_mb_largest_free_orders_locks =
+		kmalloc_array(sb->s_blocksize_bits + 2,
+			      sizeof(*sbi->s_mb_largest_free_orders_locks),
+			      GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders ||
+	    !sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < sb->s_blocksize_bits + 2; i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	spin_lock_init(&sbi->s_md_lock);
 	spin_lock_init(&sbi->s_bal_lock);
 	INIT_LIST_HEAD(&sbi->s_freed_data_list);
@@ -2777,6 +2954,10 @@ out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2832,6 +3013,8 @@ int ext4_mb_release(struct super_block *sb)
 		kvfree(group_info);
 		rcu_read_unlock();
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	iput(sbi->s_buddy_cache);
@@ -3142,6 +3325,26 @@ out_err:
 	return err;
 }
 
+/*
+ * Used with mb_adaptive_prealloc: a stream which runs out of preallocated
+ * space within MB_ADAPT_WINDOW of its previous refill gets the next one
+ * scaled up by one more power of two, a slower one is scaled back down.
+ */
+static unsigned int ext4_mb_adapt_shift(unsigned int shift,
+					unsigned long *stamp)
+{
+	unsigned long now = jiffies;
+
+	if (*stamp && time_before(now, *stamp + MB_ADAPT_WINDOW)) {
+		if (shift < MB_ADAPT_MAX_SHIFT)
+			shift++;
+	} else if (shift > 0) {
+		shift--;
+	}
+	*stamp = now;
+	return shift;
+}
+
 /*
  * here we normalize request for locality group
  * Group request are normalized to s_mb_group_prealloc, which goes to
@@ -3154,10 +3357,19 @@ out_err:
 static void ext4_mb_normalize_group_request(struct ext4_allocation_context *ac)
 {
 	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct ext4_locality_group *lg = ac->ac_lg;
+	unsigned int len = sbi->s_mb_group_prealloc;
 
 	BUG_ON(lg == NULL);
-	ac->ac_g_ex.fe_len = EXT4_SB(sb)->s_mb_group_prealloc;
+	if (sbi->s_mb_adaptive_prealloc) {
+		/* lg_mutex is held, we only get here when the lg ran dry */
+		lg->lg_prealloc_shift = ext4_mb_adapt_shift(lg->lg_prealloc_shift,
+							  &lg->lg_refill_stamp);
+		len = min_t(unsigned int, len << lg->lg_prealloc_shift,
+			    EXT4_CLUSTERS_PER_GROUP(sb));
+	}
+	ac->ac_g_ex.fe_len = len;
 	mb_debug(1, "#%u: goal %u blocks for locality group\n",
 		current->pid, ac->ac_g_ex.fe_len);
 }
@@ -3209,6 +3421,19 @@ ext4_mb_normalize_request(struct ext4_allocation_context *ac,
 		size = i_size_read(ac->ac_inode);
 	orig_size = size;
 
+	/*
+	 * An inode which keeps extending its last extent and comes back
+	 * for more soon after its previous preallocation is a fast
+	 * appender: predict its size further ahead so it refills less
+	 * often.  i_data_sem serializes us against other allocations.
+	 */
+	if (sbi->s_mb_adaptive_prealloc && ar->pleft && !ar->pright &&
+	    ar->lleft + 1 == ac->ac_o_ex.fe_logical) {
+		ei->i_mb_append_shift = ext4_mb_adapt_shift(ei->i_mb_append_shift,
+							  &ei->i_mb_append_stamp);
+		size <<= ei->i_mb_append_shift;
+	}
+
 	/* max size of free chunks */
 	max = 2 << bsbits;
 
@@ -4859,6 +5084,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	int ret;
 
 	might_sleep();
+	ext4_fc_mark_ineligible(handle, inode);
 	if (bh) {
 		if (block)
 			BUG_ON(block != bh->b_blocknr);
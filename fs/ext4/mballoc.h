@@ -89,6 +89,15 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with mb_adaptive_prealloc, a locality group or an inode that comes back
+ * for more space within MB_ADAPT_WINDOW of its previous preallocation gets
+ * its next preallocation doubled, up to 1 << MB_ADAPT_MAX_SHIFT times the
+ * default size.  Quiet streams decay back one step per refill.
+ */
+#define MB_ADAPT_WINDOW			(HZ / 10)
+#define MB_ADAPT_MAX_SHIFT		3
+
 
 struct ext4_free_data {
 	/* this links the free block information from sb_info */
@@ -155,6 +164,9 @@ struct ext4_locality_group {
 	/* list of preallocations */
 	struct list_head	lg_prealloc_list[PREALLOC_TB_SIZE];
 	spinlock_t		lg_prealloc_lock;
+	/* adaptive preallocation, protected by lg_mutex */
+	unsigned long		lg_refill_stamp;
+	unsigned int		lg_prealloc_shift;
 };
 
 struct ext4_allocation_context {
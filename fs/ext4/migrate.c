@@ -336,6 +336,7 @@ static int ext4_ext_swap_inode_data(handle_t *handle, struct inode *inode,
 	i_data[1] = ei->i_data[EXT4_DIND_BLOCK];
 	i_data[2] = ei->i_data[EXT4_TIND_BLOCK];
 
+	ext4_fc_mark_ineligible(handle, inode);
 	down_write(&EXT4_I(inode)->i_data_sem);
 	/*
 	 * if EXT4_STATE_EXT_MIGRATE is cleared a block allocation
@@ -642,6 +643,7 @@ int ext4_ind_migrate(struct inode *inode)
 	handle = ext4_journal_start(inode, EXT4_HT_MIGRATE, 1);
 	if (IS_ERR(handle))
 		return PTR_ERR(handle);
+	ext4_fc_mark_ineligible(handle, inode);
 
 	down_write(&EXT4_I(inode)->i_data_sem);
 	ret = ext4_ext_check_inode(inode);
@@ -2432,6 +2432,7 @@ out:
  */
 static void ext4_inc_count(handle_t *handle, struct inode *inode)
 {
+	ext4_fc_mark_ineligible(handle, inode);
 	inc_nlink(inode);
 	if (is_dx(inode) && inode->i_nlink > 1) {
 		/* limit is 16-bit i_links_count */
@@ -2448,6 +2449,7 @@ static void ext4_inc_count(handle_t *handle, struct inode *inode)
  */
 static void ext4_dec_count(handle_t *handle, struct inode *inode)
 {
+	ext4_fc_mark_ineligible(handle, inode);
 	if (!S_ISDIR(inode->i_mode) || inode->i_nlink > 2)
 		drop_nlink(inode);
 }
@@ -2821,6 +2823,7 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	J_ASSERT((S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 		  S_ISLNK(inode->i_mode)) || inode->i_nlink == 0);
 
+	ext4_fc_mark_ineligible(handle, inode);
 	BUFFER_TRACE(sbi->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, sbi->s_sbh);
 	if (err)
@@ -2894,6 +2897,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 		return 0;
 
 	if (handle) {
+		ext4_fc_mark_ineligible(handle, inode);
 		/* Grab inode buffer early before taking global s_orphan_lock */
 		err = ext4_reserve_inode_write(handle, inode, &iloc);
 	}
@@ -2932,6 +2936,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 
 		jbd_debug(4, "orphan inode %lu will point to %u\n",
 			  i_prev->i_ino, ino_next);
+		ext4_fc_mark_ineligible(handle, i_prev);
 		err = ext4_reserve_inode_write(handle, i_prev, &iloc2);
 		if (err) {
 			mutex_unlock(&sbi->s_orphan_lock);
@@ -3074,6 +3079,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 	if (IS_DIRSYNC(dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, inode);
 	retval = ext4_delete_entry(handle, dir, de, bh);
 	if (retval)
 		goto end_unlink;
@@ -3654,6 +3660,8 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	/* fsync after rename must make the new name durable */
+	ext4_fc_mark_ineligible(handle, old.inode);
 	if (S_ISDIR(old.inode->i_mode)) {
 		if (new.inode) {
 			retval = -ENOTEMPTY;
@@ -3854,6 +3862,8 @@ static int ext4_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, old.inode);
+	ext4_fc_mark_ineligible(handle, new.inode);
 	if (S_ISDIR(old.inode->i_mode)) {
 		old.is_dir = true;
 		retval = ext4_rename_dir_prepare(handle, &old);
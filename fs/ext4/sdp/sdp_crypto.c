@@ -15,6 +15,7 @@
  *  along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <crypto/algapi.h>
 #include <crypto/hash.h>
 #include <crypto/rng.h>
 #include <crypto/sha.h>
@@ -22,10 +23,14 @@
 #include <keys/user-type.h>
 #include <linux/delay.h>
 #include <linux/err.h>
+#include <linux/jhash.h>
 #include <linux/kernel.h>
 #include <linux/kern_levels.h>
 #include <linux/random.h>
+#include <linux/rcupdate.h>
 #include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/types.h>
 #include <uapi/linux/keyctl.h>
@@ -184,6 +189,7 @@ static void sdp_crypto_exit_sha512(void)
 
 void sdp_crypto_exit(void)
 {
+	sdp_crypto_aes_gcm_key_cache_drop();
 	sdp_crypto_exit_rng();
 	sdp_crypto_exit_sha512();
 }
@@ -421,3 +427,120 @@ void sdp_crypto_aes_gcm_key_free(struct crypto_aead *tfm)
 {
 	crypto_free_aead(tfm);
 }
+
+/*
+ * Keyed AES-GCM transforms are allocated and keyed every time a FEK or
+ * a nonce is wrapped or unwrapped, i.e. on each open of a protected
+ * file. Keep the most recent ones in a small direct-mapped cache.
+ * Lookups run under RCU, the entry lock only serializes replacement.
+ * The whole cache is dropped when a user locks the device; each drop
+ * bumps gcm_key_cache_gen so that a transform built before the drop
+ * is not inserted after it.
+ */
+#define SDP_CRYPTO_KEY_CACHE_SIZE 32
+
+struct sdp_crypto_gcm_key {
+	struct crypto_aead *tfm;
+	atomic_t refcnt;
+	size_t key_len;
+	u8 key[SDP_CRYPTO_GCM_DEFAULT_KEY_LEN];
+	struct rcu_head rcu;
+};
+
+static struct sdp_crypto_gcm_key __rcu *gcm_key_cache[SDP_CRYPTO_KEY_CACHE_SIZE];
+static DEFINE_SPINLOCK(gcm_key_cache_lock);
+static unsigned long gcm_key_cache_gen;
+
+static inline u32 sdp_crypto_gcm_key_slot(const u8 key[], size_t key_len)
+{
+	return jhash(key, key_len, 0) % SDP_CRYPTO_KEY_CACHE_SIZE;
+}
+
+void sdp_crypto_aes_gcm_key_put(struct sdp_crypto_gcm_key *gkey)
+{
+	if (!gkey || !atomic_dec_and_test(&gkey->refcnt))
+		return;
+
+	/* Readers may still compare the key, only the memory must wait */
+	crypto_free_aead(gkey->tfm);
+	memzero_explicit(gkey->key, sizeof(gkey->key));
+	kfree_rcu(gkey, rcu);
+}
+
+struct sdp_crypto_gcm_key *sdp_crypto_aes_gcm_key_get(const u8 key[], size_t key_len)
+{
+	struct sdp_crypto_gcm_key *gkey, *old;
+	struct crypto_aead *tfm;
+	unsigned long gen;
+	u32 slot;
+
+	if (key_len > SDP_CRYPTO_GCM_DEFAULT_KEY_LEN)
+		return ERR_PTR(-EINVAL);
+
+	slot = sdp_crypto_gcm_key_slot(key, key_len);
+	rcu_read_lock();
+	gkey = rcu_dereference(gcm_key_cache[slot]);
+	if (gkey && gkey->key_len == key_len &&
+			!crypto_memneq(gkey->key, key, key_len) &&
+			atomic_inc_not_zero(&gkey->refcnt)) {
+		rcu_read_unlock();
+		return gkey;
+	}
+	rcu_read_unlock();
+
+	gen = READ_ONCE(gcm_key_cache_gen);
+	tfm = sdp_crypto_aes_gcm_key_setup(key, key_len);
+	if (IS_ERR(tfm))
+		return ERR_CAST(tfm);
+
+	gkey = kzalloc(sizeof(*gkey), GFP_NOFS);
+	if (!gkey) {
+		crypto_free_aead(tfm);
+		return ERR_PTR(-ENOMEM);
+	}
+	gkey->tfm = tfm;
+	gkey->key_len = key_len;
+	memcpy(gkey->key, key, key_len);
+	atomic_set(&gkey->refcnt, 1);
+
+	spin_lock(&gcm_key_cache_lock);
+	if (gen != gcm_key_cache_gen) {
+		/* The cache was dropped meanwhile, hand out an uncached key */
+		spin_unlock(&gcm_key_cache_lock);
+		return gkey;
+	}
+	/* One more reference for the cache */
+	atomic_inc(&gkey->refcnt);
+	old = rcu_dereference_protected(gcm_key_cache[slot],
+			lockdep_is_held(&gcm_key_cache_lock));
+	rcu_assign_pointer(gcm_key_cache[slot], gkey);
+	spin_unlock(&gcm_key_cache_lock);
+
+	sdp_crypto_aes_gcm_key_put(old);
+	return gkey;
+}
+
+struct crypto_aead *sdp_crypto_aes_gcm_key_tfm(struct sdp_crypto_gcm_key *gkey)
+{
+	return gkey->tfm;
+}
+
+void sdp_crypto_aes_gcm_key_cache_drop(void)
+{
+	struct sdp_crypto_gcm_key *old;
+	int i;
+
+	spin_lock(&gcm_key_cache_lock);
+	gcm_key_cache_gen++;
+	spin_unlock(&gcm_key_cache_lock);
+
+	for (i = 0; i < SDP_CRYPTO_KEY_CACHE_SIZE; i++) {
+		spin_lock(&gcm_key_cache_lock);
+		old = rcu_dereference_protected(gcm_key_cache[i],
+				lockdep_is_held(&gcm_key_cache_lock));
+		RCU_INIT_POINTER(gcm_key_cache[i], NULL);
+		spin_unlock(&gcm_key_cache_lock);
+
+		sdp_crypto_aes_gcm_key_put(old);
+	}
+}
@@ -103,6 +103,13 @@ int sdp_crypto_aes_gcm_encrypt_pack(struct crypto_aead *tfm, gcm_pack *pack);
 int sdp_crypto_aes_gcm_decrypt_pack(struct crypto_aead *tfm, gcm_pack *pack);
 struct crypto_aead *sdp_crypto_aes_gcm_key_setup(const u8 key[], size_t key_len);
 void sdp_crypto_aes_gcm_key_free(struct crypto_aead *tfm);
+
+/* Cached keyed transforms, shared between callers */
+struct sdp_crypto_gcm_key;
+struct sdp_crypto_gcm_key *sdp_crypto_aes_gcm_key_get(const u8 key[], size_t key_len);
+struct crypto_aead *sdp_crypto_aes_gcm_key_tfm(struct sdp_crypto_gcm_key *gkey);
+void sdp_crypto_aes_gcm_key_put(struct sdp_crypto_gcm_key *gkey);
+void sdp_crypto_aes_gcm_key_cache_drop(void);
 int sdp_crypto_init(void);
 void sdp_crypto_exit(void);
 
@@ -831,6 +831,7 @@ inline int __fscrypt_get_nonce(u8 *key, u32 key_len,
 	u32 drv_buf_len = SDP_DERIVED_KEY_OUTPUT_SIZE;
 	u32 nek_len = SDP_CRYPTO_NEK_LEN;
 	int rc;
+	struct sdp_crypto_gcm_key *gkey;
 	struct crypto_aead *tfm;
 	gcm_pack32 pack;
 	gcm_pack __pack;
@@ -854,11 +855,12 @@ inline int __fscrypt_get_nonce(u8 *key, u32 key_len,
 	__pack.data = pack.data;
 	__pack.auth = pack.auth;
 
-	tfm = sdp_crypto_aes_gcm_key_setup(nek, nek_len);
-	if (IS_ERR(tfm)) {
-		rc = PTR_ERR(tfm);
+	gkey = sdp_crypto_aes_gcm_key_get(nek, nek_len);
+	if (IS_ERR(gkey)) {
+		rc = PTR_ERR(gkey);
 		goto out;
 	}
+	tfm = sdp_crypto_aes_gcm_key_tfm(gkey);
 
 	rc = sdp_crypto_aes_gcm_decrypt_pack(tfm, &__pack);
 	if (!rc) {
@@ -868,7 +870,7 @@ inline int __fscrypt_get_nonce(u8 *key, u32 key_len,
 #endif
 	}
 
-	crypto_free_aead(tfm);
+	sdp_crypto_aes_gcm_key_put(gkey);
 
 out:
 	memzero_explicit(&pack, pack_siz);
@@ -886,6 +888,7 @@ static inline int __fscrypt_set_nonce(u8 *key, u32 key_len,
 	u32 drv_buf_len = SDP_DERIVED_KEY_OUTPUT_SIZE;
 	u32 nek_len = SDP_CRYPTO_NEK_LEN;
 	int rc;
+	struct sdp_crypto_gcm_key *gkey;
 	struct crypto_aead *tfm;
 	gcm_pack32 pack;
 	gcm_pack __pack;
@@ -914,11 +917,12 @@ static inline int __fscrypt_set_nonce(u8 *key, u32 key_len,
 	__pack.auth = pack.auth;
 
 
-	tfm = sdp_crypto_aes_gcm_key_setup(nek, nek_len);
-	if (IS_ERR(tfm)) {
-		rc = PTR_ERR(tfm);
+	gkey = sdp_crypto_aes_gcm_key_get(nek, nek_len);
+	if (IS_ERR(gkey)) {
+		rc = PTR_ERR(gkey);
 		goto out;
 	}
+	tfm = sdp_crypto_aes_gcm_key_tfm(gkey);
 
 	rc = sdp_crypto_aes_gcm_encrypt_pack(tfm, &__pack);
 	if (!rc) {
@@ -928,7 +932,7 @@ static inline int __fscrypt_set_nonce(u8 *key, u32 key_len,
 #endif
 	}
 
-	crypto_free_aead(tfm);
+	sdp_crypto_aes_gcm_key_put(gkey);
 
 out:
 	memzero_explicit(&pack, pack_siz);
@@ -973,6 +973,8 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	spin_lock_init(&ei->i_raw_lock);
 	INIT_LIST_HEAD(&ei->i_prealloc_list);
 	spin_lock_init(&ei->i_prealloc_lock);
+	ei->i_mb_append_stamp = 0;
+	ei->i_mb_append_shift = 0;
 	ext4_es_init_tree(&ei->i_es_tree);
 	rwlock_init(&ei->i_es_lock);
 	INIT_LIST_HEAD(&ei->i_es_list);
@@ -994,6 +996,7 @@ static struct inode *ext4_alloc_inode(struct super_block *sb)
 	spin_lock_init(&ei->i_completed_io_lock);
 	ei->i_sync_tid = 0;
 	ei->i_datasync_tid = 0;
+	ei->i_fc_ineligible_tid = 0;
 	atomic_set(&ei->i_ioend_count, 0);
 	atomic_set(&ei->i_unwritten, 0);
 	INIT_WORK(&ei->i_rsv_conversion_work, ext4_end_io_rsv_work);
@@ -1252,6 +1255,7 @@ enum {
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
 	Opt_max_dir_size_kb, Opt_nojournal_checksum,
+	Opt_fast_commit, Opt_nofast_commit,
 };
 
 static const match_table_t tokens = {
@@ -1288,6 +1292,8 @@ static const match_table_t tokens = {
 	{Opt_journal_checksum, "journal_checksum"},
 	{Opt_nojournal_checksum, "nojournal_checksum"},
 	{Opt_journal_async_commit, "journal_async_commit"},
+	{Opt_fast_commit, "fast_commit"},
+	{Opt_nofast_commit, "nofast_commit"},
 	{Opt_abort, "abort"},
 	{Opt_data_journal, "data=journal"},
 	{Opt_data_ordered, "data=ordered"},
@@ -1479,6 +1485,10 @@ static const struct mount_opts {
 	{Opt_journal_async_commit, (EXT4_MOUNT_JOURNAL_ASYNC_COMMIT |
 				    EXT4_MOUNT_JOURNAL_CHECKSUM),
 	 MOPT_EXT4_ONLY | MOPT_SET | MOPT_EXPLICIT},
+	{Opt_fast_commit, EXT4_MOUNT_JOURNAL_FAST_COMMIT,
+	 MOPT_EXT4_ONLY | MOPT_SET},
+	{Opt_nofast_commit, EXT4_MOUNT_JOURNAL_FAST_COMMIT,
+	 MOPT_EXT4_ONLY | MOPT_CLEAR},
 	{Opt_noload, EXT4_MOUNT_NOLOAD, MOPT_NO_EXT2 | MOPT_SET},
 	{Opt_err_panic, EXT4_MOUNT_ERRORS_PANIC, MOPT_SET | MOPT_CLEAR_ERR},
 	{Opt_err_ro, EXT4_MOUNT_ERRORS_RO, MOPT_SET | MOPT_CLEAR_ERR},
@@ -3994,6 +4004,11 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 				 "journal_async_commit, fs mounted w/o journal");
 			goto failed_mount_wq;
 		}
+		if (test_opt(sb, JOURNAL_FAST_COMMIT)) {
+			ext4_msg(sb, KERN_ERR, "can't mount with "
+				 "fast_commit, fs mounted w/o journal");
+			goto failed_mount_wq;
+		}
 		if (sbi->s_commit_interval != JBD2_DEFAULT_MAX_COMMIT_AGE*HZ) {
 			ext4_msg(sb, KERN_ERR, "can't mount with "
 				 "commit=%lu, fs mounted w/o journal",
@@ -4027,6 +4042,17 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 		goto failed_mount_wq;
 	}
 
+	if (test_opt(sb, JOURNAL_FAST_COMMIT) && !(sb->s_flags & MS_RDONLY)) {
+		err = jbd2_fc_init(sbi->s_journal,
+				   min_t(unsigned int, EXT4_FC_AREA_BLOCKS,
+					 sbi->s_journal->j_maxlen / 32));
+		if (err) {
+			ext4_msg(sb, KERN_WARNING, "can't reserve fast commit "
+				 "area (%d), fast_commit disabled", err);
+			clear_opt(sb, JOURNAL_FAST_COMMIT);
+		}
+	}
+
 	/* We have now updated the journal if required, so we can
 	 * validate the data journaling mode. */
 	switch (test_opt(sb, DATA_FLAGS)) {
@@ -4365,6 +4391,7 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	journal->j_commit_interval = sbi->s_commit_interval;
 	journal->j_min_batch_time = sbi->s_min_batch_time;
 	journal->j_max_batch_time = sbi->s_max_batch_time;
+	journal->j_fc_replay_callback = ext4_fc_replay;
 
 	write_lock(&journal->j_state_lock);
 	if (test_opt(sb, BARRIER))
@@ -4964,6 +4991,13 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 		sbi->s_mount_opt ^= EXT4_MOUNT_JOURNAL_CHECKSUM;
 	}
 
+	if (test_opt(sb, JOURNAL_FAST_COMMIT) &&
+	    !(sbi->s_journal && jbd2_has_feature_fast_commit(sbi->s_journal))) {
+		ext4_msg(sb, KERN_ERR, "the fast commit area can only be "
+			 "reserved at mount time; ignoring fast_commit");
+		clear_opt(sb, JOURNAL_FAST_COMMIT);
+	}
+
 	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA) {
 		if (test_opt2(sb, EXPLICIT_DELALLOC)) {
 			ext4_msg(sb, KERN_ERR, "can't mount with "
@@ -25,6 +25,7 @@ typedef enum {
 	attr_lifetime_write_kbytes,
 	attr_reserved_clusters,
 	attr_inode_readahead,
+	attr_mb_optimize_scan,
 	attr_trigger_test_error,
 	attr_feature,
 	attr_pointer_ui,
@@ -161,6 +162,21 @@ static ssize_t reserved_clusters_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t mb_optimize_scan_store(struct ext4_attr *a,
+				      struct ext4_sb_info *sbi,
+				      const char *buf, size_t count)
+{
+	unsigned long t;
+	int ret;
+
+	ret = kstrtoul(skip_spaces(buf), 0, &t);
+	if (ret)
+		return ret;
+
+	ext4_mb_set_optimize_scan(sbi->s_sb, t);
+	return count;
+}
+
 static ssize_t trigger_test_error(struct ext4_attr *a,
 				  struct ext4_sb_info *sbi,
 				  const char *buf, size_t count)
@@ -241,6 +257,9 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_adaptive_prealloc, s_mb_adaptive_prealloc);
+EXT4_ATTR_OFFSET(mb_optimize_scan, 0644, mb_optimize_scan,
+		 ext4_sb_info, s_mb_optimize_scan);
 EXT4_RW_ATTR_SBI_UI(extent_max_zeroout_kb, s_extent_max_zeroout_kb);
 EXT4_ATTR(trigger_fs_error, 0200, trigger_test_error);
 EXT4_RW_ATTR_SBI_UI(err_ratelimit_interval_ms, s_err_ratelimit_state.interval);
@@ -278,6 +297,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_adaptive_prealloc),
+	ATTR_LIST(mb_optimize_scan),
 	ATTR_LIST(max_writeback_mb_bump),
 	ATTR_LIST(extent_max_zeroout_kb),
 	ATTR_LIST(trigger_fs_error),
@@ -354,6 +375,7 @@ static ssize_t ext4_attr_show(struct kobject *kobj,
 				(unsigned long long)
 				atomic64_read(&sbi->s_resv_clusters));
 	case attr_inode_readahead:
+	case attr_mb_optimize_scan:
 	case attr_pointer_ui:
 		if (!ptr)
 			return 0;
@@ -404,6 +426,8 @@ static ssize_t ext4_attr_store(struct kobject *kobj,
 		return len;
 	case attr_inode_readahead:
 		return inode_readahead_blks_store(a, sbi, buf, len);
+	case attr_mb_optimize_scan:
+		return mb_optimize_scan_store(a, sbi, buf, len);
 	case attr_trigger_test_error:
 		return trigger_test_error(a, sbi, buf, len);
 	}
@@ -1161,6 +1161,8 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 		return -ERANGE;
 	ext4_write_lock_xattr(inode, &no_expand);
 
+	/* Not under i_raw_lock, and the value may live in an EA block */
+	ext4_fc_mark_ineligible(handle, inode);
 	error = ext4_reserve_inode_write(handle, inode, &is.iloc);
 	if (error)
 		goto cleanup;
@@ -124,6 +124,10 @@ static void bio_post_read_processing(struct bio_post_read_ctx *ctx)
 	switch (++ctx->cur_step) {
 	case STEP_DECRYPT:
 		if (ctx->enabled_steps & (1 << STEP_DECRYPT)) {
+			if (fscrypt_decrypt_bio_inline(ctx->bio)) {
+				bio_post_read_processing(ctx);
+				return;
+			}
 			INIT_WORK(&ctx->work, decrypt_work);
 			fscrypt_enqueue_decrypt_work(&ctx->work);
 			return;
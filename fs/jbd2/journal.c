@@ -41,8 +41,10 @@
 #include <linux/log2.h>
 #include <linux/vmalloc.h>
 #include <linux/backing-dev.h>
+#include <linux/blkdev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
+#include <linux/crc32.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -101,6 +103,7 @@ EXPORT_SYMBOL(jbd2_journal_begin_ordered_truncate);
 EXPORT_SYMBOL(jbd2_inode_cache);
 
 static void __journal_abort_soft (journal_t *journal, int errno);
+static int jbd2_write_superblock(journal_t *journal, int write_op);
 static int jbd2_journal_create_slab(size_t slab_size);
 
 #ifdef CONFIG_JBD2_DEBUG
@@ -745,6 +748,217 @@ wait_commit:
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Fast commits.
+ *
+ * A fast commit makes an fsync durable without committing the running
+ * transaction: the client fs describes its changes in one block of the
+ * fast commit area, which is written with a cache flush and replayed by
+ * the client at recovery only if the transaction it belongs to did not
+ * commit.  All earlier transactions are committed before a fast commit is
+ * written, so the replay always applies on top of what log recovery
+ * leaves behind.  Whatever the client cannot describe, it makes durable
+ * with jbd2_complete_transaction() as before.
+ */
+
+__u32 jbd2_fc_block_csum(journal_t *journal, void *buf)
+{
+	jbd2_fc_header_t *fc = buf;
+	__be32 old_csum = fc->fc_checksum;
+	__u32 csum;
+
+	fc->fc_checksum = 0;
+	if (jbd2_journal_has_csum_v2or3(journal))
+		csum = jbd2_chksum(journal, journal->j_csum_seed, buf,
+				   journal->j_blocksize);
+	else
+		csum = crc32_be(~0, buf, journal->j_blocksize);
+	fc->fc_checksum = old_csum;
+
+	return csum;
+}
+
+/**
+ * int jbd2_fc_init() - Reserve a fast commit area in the journal
+ * @journal: Journal to act on.
+ * @nblocks: Number of blocks to take off the end of the log.
+ *
+ * Sets the fast commit feature on a freshly loaded journal, before any
+ * transaction was started.  The feature is incompatible, so kernels and
+ * tools which do not know about the fast commit area refuse to recover the
+ * journal instead of silently dropping the fsyncs recorded there.  A
+ * journal which already has the feature keeps its area.
+ */
+int jbd2_fc_init(journal_t *journal, unsigned int nblocks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	int err;
+
+	if (jbd2_has_feature_fast_commit(journal))
+		return 0;
+	if (journal->j_format_version < 2)
+		return -EINVAL;
+	if (!nblocks ||
+	    journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + nblocks >
+	    journal->j_last + 1)
+		return -ENOSPC;
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_head != journal->j_first) {
+		write_unlock(&journal->j_state_lock);
+		return -EBUSY;
+	}
+	journal->j_last -= nblocks;
+	journal->j_free -= nblocks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_nblocks = nblocks;
+	sb->s_num_fc_blks = cpu_to_be32(nblocks);
+	jbd2_set_feature_fast_commit(journal);
+	write_unlock(&journal->j_state_lock);
+
+	/* The area must be on disk before the first fast commit lands in it */
+	mutex_lock(&journal->j_checkpoint_mutex);
+	err = jbd2_write_superblock(journal, WRITE_FUA);
+	mutex_unlock(&journal->j_checkpoint_mutex);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_init);
+
+/**
+ * int jbd2_fc_begin_commit() - Start a fast commit of a transaction
+ * @journal: Journal to act on.
+ * @tid: Transaction the fast commit belongs to.
+ * @bhp: Returns the fast commit block to fill in.
+ *
+ * On success *@bhp is a zeroed, locked block whose payload (see
+ * jbd2_fc_payload()) the caller fills in before handing it to
+ * jbd2_fc_end_commit(); fast commits are serialised until then.
+ *
+ * Returns -EALREADY if @tid is no longer the running transaction or its
+ * commit was already requested, -ENOSPC if the fast commit area is full.
+ * On any error the caller falls back to a full commit.
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid,
+			 struct buffer_head **bhp)
+{
+	jbd2_fc_header_t *fc;
+	struct buffer_head *bh;
+	unsigned long long blocknr;
+	int err;
+
+	if (!jbd2_has_feature_fast_commit(journal))
+		return -EOPNOTSUPP;
+
+	/* Replay assumes everything before @tid has committed */
+	err = jbd2_log_wait_commit(journal, tid - 1);
+	if (err)
+		return err;
+
+	mutex_lock(&journal->j_fc_mutex);
+	read_lock(&journal->j_state_lock);
+	/*
+	 * Recovery only looks at the fast commit area when the on-disk
+	 * superblock says the log is in use, which it does not say until
+	 * the first commit after the journal was flushed (JBD2_FLUSHED).
+	 */
+	if (!journal->j_running_transaction ||
+	    journal->j_running_transaction->t_tid != tid ||
+	    tid_geq(journal->j_commit_request, tid) ||
+	    journal->j_flags & (JBD2_FLUSHED | JBD2_ABORT))
+		err = -EALREADY;
+	read_unlock(&journal->j_state_lock);
+	if (err)
+		goto out_unlock;
+
+	/*
+	 * The blocks of an older transaction are free for reuse: it has
+	 * committed by now.
+	 */
+	if (journal->j_fc_tid != tid) {
+		journal->j_fc_tid = tid;
+		journal->j_fc_off = 0;
+	}
+	if (journal->j_fc_off >= journal->j_fc_nblocks) {
+		err = -ENOSPC;
+		goto out_unlock;
+	}
+	err = jbd2_journal_bmap(journal,
+				journal->j_fc_first + journal->j_fc_off,
+				&blocknr);
+	if (err)
+		goto out_unlock;
+	bh = __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+	if (!bh) {
+		err = -ENOMEM;
+		goto out_unlock;
+	}
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, journal->j_blocksize);
+	fc = (jbd2_fc_header_t *)bh->b_data;
+	fc->fc_header.h_magic = cpu_to_be32(JBD2_MAGIC_NUMBER);
+	fc->fc_header.h_blocktype = cpu_to_be32(JBD2_FC_BLOCK);
+	fc->fc_header.h_sequence = cpu_to_be32(tid);
+	fc->fc_index = cpu_to_be32(journal->j_fc_off);
+	*bhp = bh;
+	return 0;
+
+out_unlock:
+	mutex_unlock(&journal->j_fc_mutex);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+/**
+ * int jbd2_fc_end_commit() - Write out a fast commit block
+ * @journal: Journal to act on.
+ * @bh: Block returned by jbd2_fc_begin_commit().
+ * @len: Bytes of payload filled in, 0 to abandon the fast commit.
+ *
+ * Writes @bh after flushing the device cache, so that the file data
+ * written before is stable as well, and waits for it.  Returns 0 once the
+ * fast commit is durable.
+ */
+int jbd2_fc_end_commit(journal_t *journal, struct buffer_head *bh,
+		       unsigned int len)
+{
+	jbd2_fc_header_t *fc = (jbd2_fc_header_t *)bh->b_data;
+	int write_op = WRITE_SYNC;
+	int err = 0;
+
+	if (!len) {
+		unlock_buffer(bh);
+		goto out;
+	}
+	J_ASSERT(len <= jbd2_fc_payload_size(journal));
+
+	fc->fc_len = cpu_to_be32(len);
+	fc->fc_checksum = cpu_to_be32(jbd2_fc_block_csum(journal, bh->b_data));
+
+	if (journal->j_flags & JBD2_BARRIER) {
+		if (journal->j_fs_dev != journal->j_dev)
+			blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS, NULL);
+		write_op = WRITE_FLUSH_FUA;
+	}
+	clear_buffer_dirty(bh);
+	set_buffer_uptodate(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(write_op, bh);
+	wait_on_buffer(bh);
+	if (unlikely(!buffer_uptodate(bh)))
+		err = -EIO;
+	else
+		journal->j_fc_off++;
+out:
+	brelse(bh);
+	mutex_unlock(&journal->j_fc_mutex);
+	return err;
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
 /*
  * Log buffer allocation routines:
  */
@@ -1082,6 +1296,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_reserved);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	mutex_init(&journal->j_fc_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1272,7 +1487,7 @@ static int journal_reset(journal_t *journal)
 	unsigned long long first, last;
 
 	first = be32_to_cpu(sb->s_first);
-	last = be32_to_cpu(sb->s_maxlen);
+	last = be32_to_cpu(sb->s_maxlen) - journal->j_fc_nblocks;
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD2: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1531,6 +1746,16 @@ static int journal_get_superblock(journal_t *journal)
 		goto out;
 	}
 
+	if (jbd2_has_feature_fast_commit(journal) &&
+	    (!sb->s_num_fc_blks ||
+	     be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS +
+	     be32_to_cpu(sb->s_num_fc_blks) > journal->j_maxlen + 1)) {
+		printk(KERN_WARNING
+			"JBD2: Invalid fast commit area size: %u\n",
+			be32_to_cpu(sb->s_num_fc_blks));
+		goto out;
+	}
+
 	if (jbd2_has_feature_csum2(journal) &&
 	    jbd2_has_feature_csum3(journal)) {
 		/* Can't have checksum v2 and v3 at the same time! */
@@ -1606,6 +1831,13 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
+	/* The fast commit area sits between the log and s_maxlen */
+	if (jbd2_has_feature_fast_commit(journal)) {
+		journal->j_fc_nblocks = be32_to_cpu(sb->s_num_fc_blks);
+		journal->j_last -= journal->j_fc_nblocks;
+		journal->j_fc_first = journal->j_last;
+	}
+
 	return 0;
 }
 
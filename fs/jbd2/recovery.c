@@ -43,6 +43,7 @@ static int do_one_pass(journal_t *journal,
 				struct recovery_info *info, enum passtype pass);
 static int scan_revoke_records(journal_t *, struct buffer_head *,
 				tid_t, struct recovery_info *);
+static int fc_do_replay(journal_t *journal, tid_t tid);
 
 #ifdef __KERNEL__
 
@@ -280,6 +281,10 @@ int jbd2_journal_recover(journal_t *journal)
 	jbd_debug(1, "JBD2: Replayed %d and revoked %d/%d blocks\n",
 		  info.nr_replays, info.nr_revoke_hits, info.nr_revokes);
 
+	/* Fast commits of the first transaction that did not commit */
+	if (!err)
+		err = fc_do_replay(journal, info.end_transaction);
+
 	/* Restart the log at the next transaction ID, thus invalidating
 	 * any existing commit records in the log. */
 	journal->j_transaction_sequence = ++info.end_transaction;
@@ -338,6 +343,54 @@ int jbd2_journal_skip_recovery(journal_t *journal)
 	return err;
 }
 
+/*
+ * Hand the fast commit blocks of transaction @tid to the client.  They were
+ * written to the area in order starting at its first block, so stop at the
+ * first block that is not the next one of @tid: it belongs to an older
+ * transaction, or its write was torn.
+ */
+static int fc_do_replay(journal_t *journal, tid_t tid)
+{
+	struct buffer_head *bh;
+	jbd2_fc_header_t *fc;
+	unsigned int len;
+	unsigned long i;
+	int err = 0;
+
+	if (!jbd2_has_feature_fast_commit(journal) ||
+	    !journal->j_fc_replay_callback)
+		return 0;
+
+	for (i = 0; i < journal->j_fc_nblocks; i++) {
+		err = jread(&bh, journal, journal->j_fc_first + i);
+		if (err)
+			break;
+
+		fc = (jbd2_fc_header_t *)bh->b_data;
+		len = be32_to_cpu(fc->fc_len);
+		if (fc->fc_header.h_magic != cpu_to_be32(JBD2_MAGIC_NUMBER) ||
+		    fc->fc_header.h_blocktype != cpu_to_be32(JBD2_FC_BLOCK) ||
+		    be32_to_cpu(fc->fc_header.h_sequence) != tid ||
+		    be32_to_cpu(fc->fc_index) != i ||
+		    len > jbd2_fc_payload_size(journal) ||
+		    be32_to_cpu(fc->fc_checksum) !=
+		    jbd2_fc_block_csum(journal, bh->b_data)) {
+			brelse(bh);
+			break;
+		}
+
+		err = journal->j_fc_replay_callback(journal,
+						    jbd2_fc_payload(bh), len);
+		brelse(bh);
+		if (err)
+			break;
+	}
+
+	jbd_debug(1, "JBD2: replayed %lu fast commit blocks of transaction "
+		  "%u, error %d\n", i, tid, err);
+	return err;
+}
+
 static inline unsigned long long read_tag_block(journal_t *journal,
 						journal_block_tag_t *tag)
 {
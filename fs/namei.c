@@ -1660,6 +1660,8 @@ static int lookup_fast(struct nameidata *nd,
 			if (unlikely(status <= 0)) {
 				if (status != -ECHILD)
 					need_reval = 0;
+				percpu_counter_inc(
+					&parent->d_sb->s_rcu_walk_revalidate);
 				goto unlazy;
 			}
 		}
@@ -1674,6 +1676,7 @@ static int lookup_fast(struct nameidata *nd,
 		if (likely(__follow_mount_rcu(nd, path, inode, seqp)))
 			return 0;
 unlazy:
+		percpu_counter_inc(&parent->d_sb->s_rcu_walk_fallbacks);
 		if (unlazy_walk(nd, dentry, seq))
 			return -ECHILD;
 	} else {
@@ -220,7 +220,8 @@ int ovl_set_attr(struct dentry *upperdentry, struct kstat *stat)
 
 static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 			      struct dentry *dentry, struct path *lowerpath,
-			      struct kstat *stat, const char *link)
+			      struct kstat *stat, const char *link,
+			      bool metacopy)
 {
 	struct inode *wdir = workdir->d_inode;
 	struct inode *udir = upperdir->d_inode;
@@ -247,7 +248,22 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out2;
 
-	if (S_ISREG(stat->mode)) {
+	if (metacopy) {
+		/* Sparse file of the right size, data stays on lower */
+		struct iattr attr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = stat->size,
+		};
+
+		mutex_lock(&newdentry->d_inode->i_mutex);
+		err = notify_change(newdentry, &attr, NULL);
+		mutex_unlock(&newdentry->d_inode->i_mutex);
+		if (!err)
+			err = ovl_do_setxattr(newdentry, OVL_XATTR_METACOPY,
+					      "", 0, 0);
+		if (err)
+			goto out_cleanup;
+	} else if (S_ISREG(stat->mode)) {
 		struct path upperpath;
 		ovl_path_upper(dentry, &upperpath);
 		BUG_ON(upperpath.dentry != NULL);
@@ -272,6 +288,8 @@ static int ovl_copy_up_locked(struct dentry *workdir, struct dentry *upperdir,
 	if (err)
 		goto out_cleanup;
 
+	if (metacopy)
+		ovl_dentry_set_metacopy(dentry, true);
 	ovl_dentry_update(dentry, newdentry);
 	newdentry = NULL;
 
@@ -292,6 +310,54 @@ out_cleanup:
 	goto out2;
 }
 
+/*
+ * Fill in the data of a metacopy upper from lower and drop the metacopy
+ * xattr.  The upper already carries the up to date metadata, so restore it
+ * after the data copy has bumped the times.  A crash before the xattr is
+ * removed just leaves the file metacopy, still reading from lower.
+ */
+static int ovl_copy_up_meta_data(struct dentry *dentry,
+				 struct path *lowerpath, loff_t size)
+{
+	struct path upperpath;
+	struct kstat ustat;
+	int err;
+
+	ovl_path_upper(dentry, &upperpath);
+	err = vfs_getattr(&upperpath, &ustat);
+	if (err)
+		return err;
+
+	if (size != ustat.size) {
+		struct iattr attr = {
+			.ia_valid = ATTR_SIZE,
+			.ia_size = size,
+		};
+
+		mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+		err = notify_change(upperpath.dentry, &attr, NULL);
+		mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+		if (err)
+			return err;
+	}
+
+	err = ovl_copy_up_data(lowerpath, &upperpath, size);
+	if (err)
+		return err;
+
+	err = ovl_do_removexattr(upperpath.dentry, OVL_XATTR_METACOPY);
+	if (err)
+		return err;
+
+	ovl_dentry_set_metacopy(dentry, false);
+
+	mutex_lock(&upperpath.dentry->d_inode->i_mutex);
+	err = ovl_set_attr(upperpath.dentry, &ustat);
+	mutex_unlock(&upperpath.dentry->d_inode->i_mutex);
+
+	return err;
+}
+
 /*
  * Copy up a single dentry
  *
@@ -308,7 +374,8 @@ out_cleanup:
  * that point the file will have already been copied up anyway.
  */
 int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
-		    struct path *lowerpath, struct kstat *stat)
+		    struct path *lowerpath, struct kstat *stat,
+		    bool metacopy)
 {
 	struct dentry *workdir = ovl_workdir(dentry);
 	int err;
@@ -346,11 +413,14 @@ int ovl_copy_up_one(struct dentry *parent, struct dentry *dentry,
 	if (upperdentry) {
 		/* Raced with another copy-up?  Nothing to do, then... */
 		err = 0;
+		if (!metacopy && ovl_dentry_is_metacopy(dentry))
+			err = ovl_copy_up_meta_data(dentry, lowerpath,
+						    stat->size);
 		goto out_unlock;
 	}
 
 	err = ovl_copy_up_locked(workdir, upperdir, dentry, lowerpath,
-				 stat, link);
+				 stat, link, metacopy && S_ISREG(stat->mode));
 	if (!err) {
 		/* Restore timestamps on parent (best effort) */
 		ovl_set_timestamps(upperdir, &pstat);
@@ -365,7 +435,7 @@ out_unlock:
 	return err;
 }
 
-int ovl_copy_up(struct dentry *dentry)
+static int __ovl_copy_up(struct dentry *dentry, bool metacopy)
 {
 	int err;
 
@@ -377,7 +447,8 @@ int ovl_copy_up(struct dentry *dentry)
 		struct kstat stat;
 		enum ovl_path_type type = ovl_path_type(dentry);
 
-		if (OVL_TYPE_UPPER(type))
+		if (OVL_TYPE_UPPER(type) &&
+		    (metacopy || !ovl_dentry_is_metacopy(dentry)))
 			break;
 
 		next = dget(dentry);
@@ -396,7 +467,8 @@ int ovl_copy_up(struct dentry *dentry)
 		ovl_path_lower(next, &lowerpath);
 		err = vfs_getattr(&lowerpath, &stat);
 		if (!err)
-			err = ovl_copy_up_one(parent, next, &lowerpath, &stat);
+			err = ovl_copy_up_one(parent, next, &lowerpath, &stat,
+					      metacopy && next == dentry);
 
 		dput(parent);
 		dput(next);
@@ -404,3 +476,21 @@ int ovl_copy_up(struct dentry *dentry)
 
 	return err;
 }
+
+/*
+ * Copy up everything, including the data of a file previously copied up
+ * metadata only.
+ */
+int ovl_copy_up(struct dentry *dentry)
+{
+	return __ovl_copy_up(dentry, false);
+}
+
+/*
+ * For attribute changes that leave the data alone: with "metacopy=on" a
+ * regular file only gets its metadata copied up.
+ */
+int ovl_copy_up_meta(struct dentry *dentry)
+{
+	return __ovl_copy_up(dentry, ovl_metacopy_enabled(dentry));
+}
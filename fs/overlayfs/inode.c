@@ -30,7 +30,7 @@ static int ovl_copy_up_truncate(struct dentry *dentry)
 		goto out_dput_parent;
 
 	stat.size = 0;
-	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat);
+	err = ovl_copy_up_one(parent, dentry, &lowerpath, &stat, false);
 
 out_dput_parent:
 	dput(parent);
@@ -59,7 +59,10 @@ int ovl_setattr(struct dentry *dentry, struct iattr *attr)
 	if (err)
 		goto out;
 
-	err = ovl_copy_up(dentry);
+	if (attr->ia_valid & ATTR_SIZE)
+		err = ovl_copy_up(dentry);
+	else
+		err = ovl_copy_up_meta(dentry);
 	if (!err) {
 		upperdentry = ovl_dentry_upper(dentry);
 
@@ -81,9 +84,20 @@ static int ovl_getattr(struct vfsmount *mnt, struct dentry *dentry,
 			 struct kstat *stat)
 {
 	struct path realpath;
+	struct kstat lowerstat;
+	int err;
 
 	ovl_path_real(dentry, &realpath);
-	return vfs_getattr(&realpath, stat);
+	err = vfs_getattr(&realpath, stat);
+	if (err || !ovl_dentry_is_metacopy(dentry))
+		return err;
+
+	/* Metacopy upper is sparse, the blocks are still on lower */
+	ovl_path_lower(dentry, &realpath);
+	if (!vfs_getattr(&realpath, &lowerstat))
+		stat->blocks = lowerstat.blocks;
+
+	return 0;
 }
 
 int ovl_permission(struct inode *inode, int mask)
@@ -238,7 +252,7 @@ int ovl_setxattr(struct dentry *dentry, const char *name,
 	if (ovl_is_private_xattr(name))
 		goto out_drop_write;
 
-	err = ovl_copy_up(dentry);
+	err = ovl_copy_up_meta(dentry);
 	if (err)
 		goto out_drop_write;
 
@@ -337,7 +351,7 @@ int ovl_removexattr(struct dentry *dentry, const char *name)
 		if (err < 0)
 			goto out_drop_write;
 
-		err = ovl_copy_up(dentry);
+		err = ovl_copy_up_meta(dentry);
 		if (err)
 			goto out_drop_write;
 
@@ -352,14 +366,21 @@ out:
 }
 
 static bool ovl_open_need_copy_up(int flags, enum ovl_path_type type,
-				  struct dentry *realdentry)
+				  struct dentry *realdentry, bool metacopy)
 {
-	if (OVL_TYPE_UPPER(type))
+	if (OVL_TYPE_UPPER(type) && !metacopy)
 		return false;
 
 	if (special_file(realdentry->d_inode->i_mode))
 		return false;
 
+	/*
+	 * exec takes the set-id bits and owner from file_inode(), which
+	 * would be the lower inode of a metacopy file: complete it first.
+	 */
+	if (metacopy && (flags & __FMODE_EXEC))
+		return true;
+
 	if (!(OPEN_FMODE(flags) & FMODE_WRITE) && !(flags & O_TRUNC))
 		return false;
 
@@ -371,12 +392,15 @@ struct inode *ovl_d_select_inode(struct dentry *dentry, unsigned file_flags)
 	int err;
 	struct path realpath;
 	enum ovl_path_type type;
+	bool metacopy;
 
 	if (d_is_dir(dentry))
 		return d_backing_inode(dentry);
 
 	type = ovl_path_real(dentry, &realpath);
-	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry)) {
+	metacopy = OVL_TYPE_UPPER(type) && ovl_dentry_is_metacopy(dentry);
+	if (ovl_open_need_copy_up(file_flags, type, realpath.dentry,
+				  metacopy)) {
 		err = ovl_want_write(dentry);
 		if (err)
 			return ERR_PTR(err);
@@ -390,6 +414,14 @@ struct inode *ovl_d_select_inode(struct dentry *dentry, unsigned file_flags)
 			return ERR_PTR(err);
 
 		ovl_path_upper(dentry, &realpath);
+	} else if (metacopy) {
+		/*
+		 * Data of a metacopy file is read from lower.  stat() and
+		 * fstat() still go through ovl_getattr() on the overlay
+		 * dentry and see the upper metadata, but file_inode() of the
+		 * opened file is the lower inode.
+		 */
+		ovl_path_lower(dentry, &realpath);
 	}
 
 	if (realpath.dentry->d_flags & DCACHE_OP_SELECT_INODE)
@@ -32,6 +32,7 @@ struct ovl_config {
 	char *upperdir;
 	char *workdir;
 	bool override_creds;
+	bool metacopy;
 };
 
 /* private information held for overlayfs's superblock */
@@ -57,6 +58,7 @@ struct ovl_entry {
 		struct {
 			u64 version;
 			bool opaque;
+			bool metacopy;
 		};
 		struct rcu_head rcu;
 	};
@@ -211,6 +213,31 @@ void ovl_dentry_set_opaque(struct dentry *dentry, bool opaque)
 	oe->opaque = opaque;
 }
 
+bool ovl_metacopy_enabled(struct dentry *dentry)
+{
+	struct ovl_fs *ofs = dentry->d_sb->s_fs_info;
+	return ofs->config.metacopy;
+}
+
+/*
+ * A metacopy dentry has an upper carrying the metadata while the data is
+ * still read from the lower.  Callers look at the upper dentry first, so
+ * order this load after it (pairs with smp_wmb() in ovl_dentry_update()).
+ */
+bool ovl_dentry_is_metacopy(struct dentry *dentry)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+
+	smp_rmb();
+	return ACCESS_ONCE(oe->metacopy);
+}
+
+void ovl_dentry_set_metacopy(struct dentry *dentry, bool metacopy)
+{
+	struct ovl_entry *oe = dentry->d_fsdata;
+	ACCESS_ONCE(oe->metacopy) = metacopy;
+}
+
 void ovl_dentry_update(struct dentry *dentry, struct dentry *upperdentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -280,6 +307,18 @@ static bool ovl_is_opaquedir(struct dentry *dentry)
 	return false;
 }
 
+static bool ovl_is_metacopy(struct dentry *dentry)
+{
+	int res;
+	struct inode *inode = dentry->d_inode;
+
+	if (!S_ISREG(inode->i_mode) || !inode->i_op->getxattr)
+		return false;
+
+	res = inode->i_op->getxattr(dentry, OVL_XATTR_METACOPY, NULL, 0);
+	return res >= 0;
+}
+
 static void ovl_dentry_release(struct dentry *dentry)
 {
 	struct ovl_entry *oe = dentry->d_fsdata;
@@ -460,6 +499,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	unsigned int ctr = 0;
 	struct inode *inode = NULL;
 	bool upperopaque = false;
+	bool metacopy = false;
 	struct dentry *this, *prev = NULL;
 	unsigned int i;
 	int err;
@@ -483,6 +523,8 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 				upperopaque = true;
 			} else if (poe->numlower && ovl_is_opaquedir(this)) {
 				upperopaque = true;
+			} else if (ovl_is_metacopy(this)) {
+				metacopy = true;
 			}
 		}
 		upperdentry = prev = this;
@@ -528,8 +570,16 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			 * FIXME: check for upper-opaqueness maybe better done
 			 * in remove code.
 			 */
-			if (prev == upperdentry)
+			if (prev == upperdentry) {
 				upperopaque = true;
+				/* Metacopy upper still reads data from here */
+				if (metacopy && S_ISREG(this->d_inode->i_mode)) {
+					stack[ctr].dentry = this;
+					stack[ctr].mnt = lowerpath.mnt;
+					ctr++;
+					break;
+				}
+			}
 			dput(this);
 			break;
 		}
@@ -547,6 +597,14 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 			break;
 	}
 
+	/* The lower holding the data of a metacopy upper has gone away */
+	err = -EIO;
+	if (metacopy && !ctr) {
+		pr_warn_ratelimited("overlayfs: no lower data for metacopy %pd2\n",
+				    upperdentry);
+		goto out_put;
+	}
+
 	oe = ovl_alloc_entry(ctr);
 	err = -ENOMEM;
 	if (!oe)
@@ -566,6 +624,7 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	}
 
 	oe->opaque = upperopaque;
+	oe->metacopy = metacopy;
 	oe->__upperdentry = upperdentry;
 	memcpy(oe->lowerstack, stack, sizeof(struct path) * ctr);
 	kfree(stack);
@@ -640,6 +699,11 @@ module_param_named(override_creds, ovl_override_creds_def, bool, 0644);
 MODULE_PARM_DESC(ovl_override_creds_def,
 		 "Use mounter's credentials for accesses");
 
+static bool __read_mostly ovl_metacopy_def = false;
+module_param_named(metacopy, ovl_metacopy_def, bool, 0644);
+MODULE_PARM_DESC(ovl_metacopy_def,
+		 "Copy up only metadata on attribute changes");
+
 /**
  * ovl_show_options
  *
@@ -659,6 +723,9 @@ static int ovl_show_options(struct seq_file *m, struct dentry *dentry)
 	if (ufs->config.override_creds != ovl_override_creds_def)
 		seq_show_option(m, "override_creds",
 				ufs->config.override_creds ? "on" : "off");
+	if (ufs->config.metacopy != ovl_metacopy_def)
+		seq_show_option(m, "metacopy",
+				ufs->config.metacopy ? "on" : "off");
 	return 0;
 }
 
@@ -685,6 +752,8 @@ enum {
 	OPT_WORKDIR,
 	OPT_OVERRIDE_CREDS_ON,
 	OPT_OVERRIDE_CREDS_OFF,
+	OPT_METACOPY_ON,
+	OPT_METACOPY_OFF,
 	OPT_ERR,
 };
 
@@ -694,6 +763,8 @@ static const match_table_t ovl_tokens = {
 	{OPT_WORKDIR,			"workdir=%s"},
 	{OPT_OVERRIDE_CREDS_ON,		"override_creds=on"},
 	{OPT_OVERRIDE_CREDS_OFF,	"override_creds=off"},
+	{OPT_METACOPY_ON,		"metacopy=on"},
+	{OPT_METACOPY_OFF,		"metacopy=off"},
 	{OPT_ERR,			NULL}
 };
 
@@ -725,6 +796,7 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 	char *p;
 
 	config->override_creds = ovl_override_creds_def;
+	config->metacopy = ovl_metacopy_def;
 	while ((p = ovl_next_opt(&opt)) != NULL) {
 		int token;
 		substring_t args[MAX_OPT_ARGS];
@@ -763,6 +835,14 @@ static int ovl_parse_opt(char *opt, struct ovl_config *config)
 			config->override_creds = false;
 			break;
 
+		case OPT_METACOPY_ON:
+			config->metacopy = true;
+			break;
+
+		case OPT_METACOPY_OFF:
+			config->metacopy = false;
+			break;
+
 		default:
 			pr_err("overlayfs: unrecognized mount option \"%s\" or missing value\n", p);
 			return -EINVAL;
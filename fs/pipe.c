@@ -59,6 +59,20 @@ unsigned int pipe_min_size = PAGE_SIZE;
 unsigned long pipe_user_pages_hard;
 unsigned long pipe_user_pages_soft = PIPE_DEF_BUFFERS * INR_OPEN_CUR;
 
+/*
+ * Adaptive pipe sizing, off while 0: a writer that keeps finding the pipe
+ * full doubles the ring, up to this size and pipe_max_size, and the ring
+ * goes back to its previous size once the reader has kept up for a while.
+ * Can be set by root in /proc/sys/fs/pipe-adaptive-max-size
+ */
+unsigned int pipe_adaptive_max_size;
+
+#define PIPE_ADAPT_FULLS	4
+#define PIPE_ADAPT_IDLE		HZ
+
+static bool pipe_adapt_grow(struct pipe_inode_info *pipe);
+static void pipe_adapt_shrink(struct pipe_inode_info *pipe);
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -338,6 +352,8 @@ pipe_read(struct kiocb *iocb, struct iov_iter *to)
 		}
 		pipe_wait(pipe);
 	}
+	if (!pipe->nrbufs)
+		pipe_adapt_shrink(pipe);
 	__pipe_unlock(pipe);
 
 	/* Signal writers asynchronously that there is more room. */
@@ -459,6 +475,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		}
 		if (bufs < pipe->buffers)
 			continue;
+		if (pipe_adapt_grow(pipe))
+			continue;
 		if (filp->f_flags & O_NONBLOCK) {
 			if (!ret)
 				ret = -EAGAIN;
@@ -1064,6 +1082,49 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	return nr_pages * PAGE_SIZE;
 }
 
+/*
+ * Called with the pipe full and the writer about to wait. Returns true if
+ * the ring was grown and the writer can go on.
+ */
+static bool pipe_adapt_grow(struct pipe_inode_info *pipe)
+{
+	unsigned long now = jiffies;
+	unsigned int max_pages, floor;
+
+	if (!pipe_adaptive_max_size)
+		return false;
+
+	if (time_after(now, pipe->adapt_last_full + PIPE_ADAPT_IDLE))
+		pipe->adapt_fulls = 0;
+	pipe->adapt_last_full = now;
+	if (++pipe->adapt_fulls < PIPE_ADAPT_FULLS)
+		return false;
+	pipe->adapt_fulls = 0;
+
+	max_pages = min(pipe_adaptive_max_size, pipe_max_size) >> PAGE_SHIFT;
+	if (pipe->buffers * 2 > max_pages ||
+	    too_many_pipe_buffers_hard(pipe->user) ||
+	    too_many_pipe_buffers_soft(pipe->user))
+		return false;
+
+	floor = pipe->adapt_floor ? : pipe->buffers;
+	if (pipe_set_size(pipe, pipe->buffers * 2) < 0)
+		return false;
+	pipe->adapt_floor = floor;
+	return true;
+}
+
+/* Called with the pipe empty after a read */
+static void pipe_adapt_shrink(struct pipe_inode_info *pipe)
+{
+	if (!pipe->adapt_floor)
+		return;
+	if (time_before(jiffies, pipe->adapt_last_full + PIPE_ADAPT_IDLE))
+		return;
+	if (pipe_set_size(pipe, pipe->adapt_floor) >= 0)
+		pipe->adapt_floor = 0;
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages. Returns 0 on error.
@@ -1146,6 +1207,8 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto out;
 		}
 		ret = pipe_set_size(pipe, nr_pages);
+		if (ret > 0)
+			pipe->adapt_floor = 0;
 		break;
 		}
 	case F_GETPIPE_SZ:
@@ -501,7 +501,91 @@ out:
 	return 0;
 }
 
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	pgoff_t last_page = (i_size_read(inode) + PAGE_CACHE_SIZE - 1) >>
+					PAGE_CACHE_SHIFT;
+	struct squashfs_read_job *job = NULL, *first = NULL;
+
+	TRACE("Entered squashfs_readpages, %u pages, start block %llx\n",
+				nr_pages, squashfs_i(inode)->start);
+
+	/* Walk the readahead list from its tail, in increasing index order */
+	while (!list_empty(pages)) {
+		struct page *page = list_entry(pages->prev, struct page, lru);
+		int index = page->index >> shift;
+		u64 block = 0;
+		int bsize;
+
+		list_del(&page->lru);
+		if (add_to_page_cache_lru(page, mapping, page->index,
+				mapping_gfp_constraint(mapping, GFP_KERNEL))) {
+			page_cache_release(page);
+			continue;
+		}
+
+		if (page->index >= last_page)
+			goto readpage;
+
+		if (job && squashfs_read_job_index(job) != index) {
+			/*
+			 * The first block is most likely waited for, it is
+			 * decompressed by the caller once the rest are queued
+			 */
+			if (first == NULL)
+				first = job;
+			else
+				squashfs_read_job_submit(job, 0);
+			job = NULL;
+		}
+
+		if (job == NULL) {
+			/* Fragments and sparse blocks take the slow path */
+			if (index >= file_end && squashfs_i(inode)->fragment_block
+					!= SQUASHFS_INVALID_BLK)
+				goto readpage;
+
+			bsize = read_blocklist(inode, index, &block);
+			if (bsize <= 0)
+				goto readpage;
+
+			job = squashfs_read_job_alloc(inode, index, block,
+						      bsize);
+			if (job == NULL)
+				goto readpage;
+		}
+
+		squashfs_read_job_add_page(job, page);
+		continue;
+
+readpage:
+		squashfs_readpage(file, page);
+		page_cache_release(page);
+	}
+
+	if (job) {
+		if (first == NULL)
+			first = job;
+		else
+			squashfs_read_job_submit(job, 0);
+	}
+	if (first)
+		squashfs_read_job_submit(first, 1);
+
+	return 0;
+}
+#endif /* CONFIG_SQUASHFS_READAHEAD_PARALLEL */
+
 
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+	.readpages = squashfs_readpages,
+#endif
 };
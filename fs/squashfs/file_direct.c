@@ -13,6 +13,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -20,60 +21,22 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
-
-/* Read separately compressed datablock directly into page cache */
-int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+static int squashfs_read_cache(struct inode *inode, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page);
 
+/*
+ * Decompress a datablock into the pages covering it. All non-NULL pages
+ * are locked on entry and are unlocked and released on return, except
+ * target_page which is dealt with by the caller on error.
+ */
+static int squashfs_read_block_pages(struct inode *inode,
+	struct page *target_page, u64 block, int bsize, struct page **page,
+	int pages, int missing_pages)
 {
-	struct inode *inode = target_page->mapping->host;
-	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
-
-	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
-	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
-	int start_index = target_page->index & ~mask;
-	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
-	struct page **page;
-	struct squashfs_page_actor *actor;
+	int i, bytes, res = -ENOMEM;
+	struct squashfs_page_actor *actor = NULL;
 	void *pageaddr;
 
-	if (end_index > file_end)
-		end_index = file_end;
-
-	pages = end_index - start_index + 1;
-
-	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
-	if (page == NULL)
-		return res;
-
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
-
-	/* Try to grab all the pages covered by the Squashfs block */
-	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
-		page[i] = (n == target_page->index) ? target_page :
-			grab_cache_page_nowait(target_page->mapping, n);
-
-		if (page[i] == NULL) {
-			missing_pages++;
-			continue;
-		}
-
-		if (PageUptodate(page[i])) {
-			unlock_page(page[i]);
-			page_cache_release(page[i]);
-			page[i] = NULL;
-			missing_pages++;
-		}
-	}
-
 	if (missing_pages) {
 		/*
 		 * Couldn't get one or more pages, this page has either
@@ -82,14 +45,22 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-								page);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+								pages, page);
 		if (res < 0)
 			goto mark_errored;
 
-		goto out;
+		return res;
 	}
 
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
 	if (res < 0)
@@ -113,8 +84,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 	}
 
 	kfree(actor);
-	kfree(page);
-
 	return 0;
 
 mark_errored:
@@ -130,17 +99,175 @@ mark_errored:
 		page_cache_release(page[i]);
 	}
 
-out:
 	kfree(actor);
+	return res;
+}
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int i, n, pages, missing_pages, res = -ENOMEM;
+	struct page **page;
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return res;
+
+	/* Try to grab all the pages covered by the Squashfs block */
+	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] == NULL) {
+			missing_pages++;
+			continue;
+		}
+
+		if (PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			missing_pages++;
+		}
+	}
+
+	res = squashfs_read_block_pages(inode, target_page, block, bsize,
+					page, pages, missing_pages);
 	kfree(page);
 	return res;
 }
 
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+/*
+ * Readahead decompresses the datablocks it covers concurrently: every
+ * block but the first one is handed to squashfs_read_wq, so with the
+ * percpu decompressor each worker gets its own stream. Pages stay locked
+ * until their block is done, readers simply wait on the page lock.
+ */
+struct squashfs_read_job {
+	struct work_struct	work;
+	struct inode		*inode;
+	u64			block;
+	int			bsize;
+	int			index;
+	pgoff_t			start_index;
+	int			pages;
+	struct page		*page[0];
+};
+
+static struct workqueue_struct *squashfs_read_wq;
+
+struct squashfs_read_job *squashfs_read_job_alloc(struct inode *inode,
+	int index, u64 block, int bsize)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	pgoff_t file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	pgoff_t start_index = (pgoff_t)index << shift;
+	pgoff_t end_index = start_index | ((1 << shift) - 1);
+	struct squashfs_read_job *job;
+	int pages;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	job = kzalloc(sizeof(*job) + pages * sizeof(struct page *), GFP_NOFS);
+	if (job == NULL)
+		return NULL;
+
+	job->inode = inode;
+	job->block = block;
+	job->bsize = bsize;
+	job->index = index;
+	job->start_index = start_index;
+	job->pages = pages;
+	return job;
+}
+
+int squashfs_read_job_index(struct squashfs_read_job *job)
+{
+	return job->index;
+}
+
+void squashfs_read_job_add_page(struct squashfs_read_job *job,
+	struct page *page)
+{
+	job->page[page->index - job->start_index] = page;
+}
+
+static void squashfs_read_job_run(struct squashfs_read_job *job)
+{
+	int i, missing_pages = 0;
+
+	/* Pages of the block that readahead did not hand us */
+	for (i = 0; i < job->pages; i++) {
+		if (job->page[i])
+			continue;
+
+		job->page[i] = grab_cache_page_nowait(job->inode->i_mapping,
+						      job->start_index + i);
+		if (job->page[i] && PageUptodate(job->page[i])) {
+			unlock_page(job->page[i]);
+			page_cache_release(job->page[i]);
+			job->page[i] = NULL;
+		}
+		if (job->page[i] == NULL)
+			missing_pages++;
+	}
+
+	squashfs_read_block_pages(job->inode, NULL, job->block, job->bsize,
+				  job->page, job->pages, missing_pages);
+	kfree(job);
+}
+
+static void squashfs_read_job_work(struct work_struct *work)
+{
+	squashfs_read_job_run(container_of(work, struct squashfs_read_job,
+					   work));
+}
+
+void squashfs_read_job_submit(struct squashfs_read_job *job, int sync)
+{
+	if (sync || squashfs_read_wq == NULL) {
+		squashfs_read_job_run(job);
+		return;
+	}
+
+	INIT_WORK(&job->work, squashfs_read_job_work);
+	queue_work(squashfs_read_wq, &job->work);
+}
+
+int __init squashfs_read_wq_init(void)
+{
+	squashfs_read_wq = alloc_workqueue("squashfs_read",
+					   WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	return squashfs_read_wq ? 0 : -ENOMEM;
+}
+
+void squashfs_read_wq_destroy(void)
+{
+	destroy_workqueue(squashfs_read_wq);
+}
+#endif /* CONFIG_SQUASHFS_READAHEAD_PARALLEL */
+
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page)
 {
-	struct inode *i = target_page->mapping->host;
 	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
 						 block, bsize);
 	int bytes = buffer->length, res = buffer->error, n, offset = 0;
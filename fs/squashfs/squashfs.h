@@ -73,6 +73,28 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
 
+/* file_direct.c */
+#ifdef CONFIG_SQUASHFS_READAHEAD_PARALLEL
+struct squashfs_read_job;
+extern struct squashfs_read_job *squashfs_read_job_alloc(struct inode *, int,
+				u64, int);
+extern int squashfs_read_job_index(struct squashfs_read_job *);
+extern void squashfs_read_job_add_page(struct squashfs_read_job *,
+				struct page *);
+extern void squashfs_read_job_submit(struct squashfs_read_job *, int);
+extern int squashfs_read_wq_init(void);
+extern void squashfs_read_wq_destroy(void);
+#else
+static inline int squashfs_read_wq_init(void)
+{
+	return 0;
+}
+
+static inline void squashfs_read_wq_destroy(void)
+{
+}
+#endif
+
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
 extern __le64 *squashfs_read_id_index_table(struct super_block *, u64, u64,
@@ -445,8 +445,15 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_read_wq_init();
+	if (err) {
+		destroy_inodecache();
+		return err;
+	}
+
 	err = register_filesystem(&squashfs_fs_type);
 	if (err) {
+		squashfs_read_wq_destroy();
 		destroy_inodecache();
 		return err;
 	}
@@ -460,6 +467,7 @@ static int __init init_squashfs_fs(void)
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_read_wq_destroy();
 	destroy_inodecache();
 }
 
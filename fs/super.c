@@ -154,6 +154,9 @@ static void destroy_super_work(struct work_struct *work)
 
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_free_rwsem(&s->s_writers.rw_sem[i]);
+	percpu_counter_destroy(&s->s_nr_negative_dentry);
+	percpu_counter_destroy(&s->s_rcu_walk_fallbacks);
+	percpu_counter_destroy(&s->s_rcu_walk_revalidate);
 	kfree(s);
 }
 
@@ -226,6 +229,10 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 		goto fail;
 	if (list_lru_init_memcg(&s->s_inode_lru))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_negative_dentry, 0, GFP_KERNEL) ||
+	    percpu_counter_init(&s->s_rcu_walk_fallbacks, 0, GFP_KERNEL) ||
+	    percpu_counter_init(&s->s_rcu_walk_revalidate, 0, GFP_KERNEL))
+		goto fail;
 
 	init_rwsem(&s->s_umount);
 	lockdep_set_class(&s->s_umount, &type->s_umount_key);
@@ -64,6 +64,7 @@ struct dentry_stat_t {
 	long dummy[2];
 };
 extern struct dentry_stat_t dentry_stat;
+extern unsigned long sysctl_negative_dentry_limit;
 
 /* Name hashing routines. Initial hash value */
 /* Hash courtesy of the R5 hash in reiserfs modulo sign bits */
@@ -29,6 +29,7 @@
 #include <linux/uidgid.h>
 #include <linux/lockdep.h>
 #include <linux/percpu-rwsem.h>
+#include <linux/percpu_counter.h>
 #include <linux/blk_types.h>
 #include <linux/workqueue.h>
 #include <linux/percpu-rwsem.h>
@@ -908,6 +909,10 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+#ifdef CONFIG_ADAPTIVE_READAHEAD
+	short ra_shift;			/* Window limit is ra_pages << ra_shift */
+	unsigned short ra_hits;		/* Consecutive full windows consumed */
+#endif
 };
 
 /*
@@ -1443,6 +1448,13 @@ struct super_block {
 	/* Number of inodes with nlink == 0 but still referenced */
 	atomic_long_t s_remove_count;
 
+	/* Number of unused negative dentries, see negative-dentry-limit */
+	struct percpu_counter s_nr_negative_dentry;
+
+	/* Path walks that had to drop out of rcu-walk here, and why */
+	struct percpu_counter s_rcu_walk_fallbacks;
+	struct percpu_counter s_rcu_walk_revalidate;
+
 	/* Being remounted read-only */
 	int s_readonly_remount;
 
@@ -158,6 +158,11 @@ static inline void fscrypt_decrypt_bio(struct bio *bio)
 {
 }
 
+static inline bool fscrypt_decrypt_bio_inline(struct bio *bio)
+{
+	return false;
+}
+
 static inline void fscrypt_enqueue_decrypt_bio(struct fscrypt_ctx *ctx,
 					       struct bio *bio)
 {
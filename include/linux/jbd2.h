@@ -126,6 +126,7 @@ typedef struct journal_s	journal_t;	/* Journal control structure */
 #define JBD2_SUPERBLOCK_V1	3
 #define JBD2_SUPERBLOCK_V2	4
 #define JBD2_REVOKE_BLOCK	5
+#define JBD2_FC_BLOCK		6
 
 /*
  * Standard header for all descriptor blocks:
@@ -220,6 +221,22 @@ struct jbd2_journal_revoke_tail {
 	__be32		r_checksum;	/* crc32c(uuid+revoke_block) */
 };
 
+/*
+ * Fast commit block: written to the area reserved at the end of the journal
+ * when FEATURE_INCOMPAT_FAST_COMMIT is set, never part of the log itself.
+ * h_sequence is the transaction the block is a fast commit of, fc_index its
+ * position in the area.  fc_checksum covers the whole block (with the field
+ * zeroed): crc32c(uuid+block) with checksum v2/v3, crc32_be otherwise.
+ * The fc_len bytes after the header are interpreted by the client fs.
+ */
+typedef struct jbd2_fc_header_s
+{
+	journal_header_t fc_header;
+	__be32		fc_index;
+	__be32		fc_len;
+	__be32		fc_checksum;
+} jbd2_fc_header_t;
+
 /* Definitions for the journal tag flags word: */
 #define JBD2_FLAG_ESCAPE		1	/* on-disk block is escaped */
 #define JBD2_FLAG_SAME_UUID	2	/* block has same uuid as previous */
@@ -270,7 +287,9 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+/* 0x0054 */
+	__be32	s_num_fc_blks;		/* Number of fast commit blocks */
+	__u32	s_padding[41];
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -296,6 +315,7 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
 #define JBD2_FEATURE_INCOMPAT_CSUM_V3		0x00000010
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT	0x00000040
 
 /* See "journal feature predicate functions" below */
 
@@ -306,7 +326,8 @@ typedef struct journal_superblock_s
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
 					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V3)
+					JBD2_FEATURE_INCOMPAT_CSUM_V3 | \
+					JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -754,6 +775,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_free: Journal free - how many free blocks are there in the journal?
  * @j_first: The block number of the first usable block
  * @j_last: The block number one beyond the last usable block
+ * @j_fc_first: The block number of the first fast commit block
+ * @j_fc_nblocks: Number of blocks in the fast commit area
  * @j_dev: Device where we store the journal
  * @j_blocksize: blocksize for the location where we store the journal.
  * @j_blk_offset: starting block offset for into the device where we store the
@@ -792,6 +815,10 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_fc_mutex: Serialises fast commits
+ * @j_fc_tid: Transaction the blocks in the fast commit area belong to
+ * @j_fc_off: Next free block in the fast commit area
+ * @j_fc_replay_callback: Client callback replaying one fast commit block
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -898,6 +925,14 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area: j_fc_nblocks blocks starting at j_fc_first, just
+	 * beyond j_last.  Empty unless the journal has the fast commit
+	 * feature. [j_state_lock]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_nblocks;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -1014,6 +1049,18 @@ struct journal_s
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
+	/*
+	 * Fast commits: the transaction the blocks in the fast commit area
+	 * belong to and the next free block there. [j_fc_mutex]
+	 */
+	struct mutex		j_fc_mutex;
+	tid_t			j_fc_tid;
+	unsigned long		j_fc_off;
+
+	/* Called by recovery for each fast commit block to be replayed */
+	int			(*j_fc_replay_callback)(journal_t *, void *,
+							unsigned int);
+
 	/*
 	 * Journal statistics
 	 */
@@ -1099,6 +1146,7 @@ JBD2_FEATURE_INCOMPAT_FUNCS(64bit,		64BIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(async_commit,	ASYNC_COMMIT)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum2,		CSUM_V2)
 JBD2_FEATURE_INCOMPAT_FUNCS(csum3,		CSUM_V3)
+JBD2_FEATURE_INCOMPAT_FUNCS(fast_commit,	FAST_COMMIT)
 
 /*
  * Journal flag definitions
@@ -1358,6 +1406,25 @@ int jbd2_complete_transaction(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
+/* Fast commit support */
+int jbd2_fc_init(journal_t *journal, unsigned int nblocks);
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid,
+			 struct buffer_head **bhp);
+int jbd2_fc_end_commit(journal_t *journal, struct buffer_head *bh,
+		       unsigned int len);
+__u32 jbd2_fc_block_csum(journal_t *journal, void *buf);
+
+/* Payload of a fast commit block, past its jbd2_fc_header_t */
+static inline void *jbd2_fc_payload(struct buffer_head *bh)
+{
+	return bh->b_data + sizeof(jbd2_fc_header_t);
+}
+
+static inline unsigned int jbd2_fc_payload_size(journal_t *journal)
+{
+	return journal->j_blocksize - sizeof(jbd2_fc_header_t);
+}
+
 void __jbd2_log_wait_for_space(journal_t *journal);
 extern void __jbd2_journal_drop_transaction(journal_t *, transaction_t *);
 extern int jbd2_cleanup_journal_tail(journal_t *);
@@ -43,6 +43,9 @@ struct pipe_buffer {
  *	@fasync_writers: writer side fasync
  *	@bufs: the circular array of pipe buffers
  *	@user: the user who created this pipe
+ *	@adapt_fulls: times the writer found the pipe full lately
+ *	@adapt_floor: size to shrink back to, 0 if not grown adaptively
+ *	@adapt_last_full: jiffies when the writer last found the pipe full
  **/
 struct pipe_inode_info {
 	struct mutex mutex;
@@ -59,6 +62,9 @@ struct pipe_inode_info {
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
 	struct user_struct *user;
+	unsigned int adapt_fulls;
+	unsigned int adapt_floor;
+	unsigned long adapt_last_full;
 };
 
 /*
@@ -138,6 +144,7 @@ void pipe_unlock(struct pipe_inode_info *);
 void pipe_double_lock(struct pipe_inode_info *, struct pipe_inode_info *);
 
 extern unsigned int pipe_max_size, pipe_min_size;
+extern unsigned int pipe_adaptive_max_size;
 extern unsigned long pipe_user_pages_hard;
 extern unsigned long pipe_user_pages_soft;
 int pipe_proc_fn(struct ctl_table *, int, void __user *, size_t *, loff_t *);
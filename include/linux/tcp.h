@@ -249,6 +249,7 @@ struct tcp_sock {
 
 	struct list_head tsq_node; /* anchor in tsq_tasklet.head list */
 	unsigned long	tsq_flags;
+	struct hrtimer	pacing_timer;	/* internal pacing, see tcp_internal_pacing() */
 
 	/* Data for direct copy to user */
 	struct {
@@ -1551,6 +1551,48 @@ static void shrink_readahead_size_eio(struct file *filp,
 	ra->ra_pages /= 4;
 }
 
+/*
+ * Pages of a multi-page read are looked up in batches: a single walk of
+ * the radix tree under rcu finds up to PAGEVEC_SIZE contiguous cached
+ * pages, instead of one walk per page.  Each page still gets its own
+ * speculative reference.  The references held for the pages after the
+ * current one would make invalidation, migration and compaction fail
+ * with -EBUSY, so the batch is dropped before anything that may sleep
+ * or fault.
+ */
+struct read_batch {
+	unsigned int nr;
+	unsigned int idx;
+	struct page *pages[PAGEVEC_SIZE];
+};
+
+static void read_batch_release(struct read_batch *batch)
+{
+	while (batch->idx < batch->nr)
+		page_cache_release(batch->pages[batch->idx++]);
+	batch->nr = batch->idx = 0;
+}
+
+static struct page *read_batch_get_page(struct address_space *mapping,
+					struct read_batch *batch,
+					pgoff_t index, pgoff_t last_index)
+{
+	unsigned int nr;
+
+	if (batch->idx < batch->nr && batch->pages[batch->idx]->index == index)
+		return batch->pages[batch->idx++];
+
+	read_batch_release(batch);
+	if (last_index - index <= 1)
+		return find_get_page(mapping, index);
+
+	nr = min_t(pgoff_t, last_index - index, PAGEVEC_SIZE);
+	batch->nr = find_get_pages_contig(mapping, index, nr, batch->pages);
+	if (!batch->nr)
+		return NULL;
+	return batch->pages[batch->idx++];
+}
+
 /**
  * do_generic_file_read - generic file read routine
  * @filp:	the file to read
@@ -1575,6 +1617,7 @@ static ssize_t do_generic_file_read(struct file *filp, loff_t *ppos,
 	pgoff_t prev_index;
 	unsigned long offset;      /* offset into pagecache page */
 	unsigned int prev_offset;
+	struct read_batch batch = { .nr = 0, .idx = 0 };
 	int error = 0;
 
 	index = *ppos >> PAGE_CACHE_SHIFT;
@@ -1591,6 +1634,8 @@ static ssize_t do_generic_file_read(struct file *filp, loff_t *ppos,
 		loff_t isize;
 		unsigned long nr, ret;
 
+		if (need_resched())
+			read_batch_release(&batch);
 		cond_resched();
 find_page:
 		if (fatal_signal_pending(current)) {
@@ -1598,21 +1643,24 @@ find_page:
 			goto out;
 		}
 
-		page = find_get_page(mapping, index);
+		page = read_batch_get_page(mapping, &batch, index, last_index);
 		if (!page) {
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
-			page = find_get_page(mapping, index);
+			page = read_batch_get_page(mapping, &batch,
+						   index, last_index);
 			if (unlikely(page == NULL))
 				goto no_cached_page;
 		}
 		if (PageReadahead(page)) {
+			read_batch_release(&batch);
 			page_cache_async_readahead(mapping,
 					ra, filp, page,
 					index, last_index - index);
 		}
 		if (!PageUptodate(page)) {
+			read_batch_release(&batch);
 			/*
 			 * See comment in do_read_cache_page on why
 			 * wait_on_page_locked is used to avoid unnecessarily
@@ -1683,7 +1731,19 @@ page_ok:
 		 * now we can copy it to user space...
 		 */
 
-		ret = copy_page_to_iter(page, offset, nr, iter);
+		if (batch.idx < batch.nr) {
+			/* Only fault in the user buffer without the batch */
+			pagefault_disable();
+			ret = copy_page_to_iter(page, offset, nr, iter);
+			pagefault_enable();
+			if (ret < nr) {
+				read_batch_release(&batch);
+				ret += copy_page_to_iter(page, offset + ret,
+							 nr - ret, iter);
+			}
+		} else {
+			ret = copy_page_to_iter(page, offset, nr, iter);
+		}
 		offset += ret;
 		index += offset >> PAGE_CACHE_SHIFT;
 		offset &= ~PAGE_CACHE_MASK;
@@ -1700,6 +1760,7 @@ page_ok:
 		continue;
 
 page_not_up_to_date:
+		read_batch_release(&batch);
 		/* Get exclusive access to the page ... */
 		error = lock_page_killable(page);
 		if (unlikely(error))
@@ -1790,6 +1851,7 @@ no_cached_page:
 	}
 
 out:
+	read_batch_release(&batch);
 	ra->prev_pos = prev_index;
 	ra->prev_pos <<= PAGE_CACHE_SHIFT;
 	ra->prev_pos |= prev_offset;
@@ -29,6 +29,10 @@ file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = inode_to_bdi(mapping->host)->ra_pages;
 	ra->prev_pos = -1;
+#ifdef CONFIG_ADAPTIVE_READAHEAD
+	ra->ra_shift = 0;
+	ra->ra_hits = 0;
+#endif
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
@@ -279,6 +283,66 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
 	return min(newsize, max);
 }
 
+#ifdef CONFIG_ADAPTIVE_READAHEAD
+#define RA_ADAPT_MAX_SHIFT	2	/* up to 4 * ra_pages */
+#define RA_ADAPT_MIN_SHIFT	3	/* down to ra_pages / 8 */
+#define RA_ADAPT_MIN_PAGES	4
+#define RA_ADAPT_HITS		4
+
+/*
+ * Per-file limit of the readahead window.  It moves away from ra_pages by
+ * powers of two as the file shows it wastes or fully uses its readahead.
+ */
+static unsigned long ra_adapt_max(struct file_ra_state *ra)
+{
+	if (ra->ra_shift >= 0)
+		return ra->ra_pages << ra->ra_shift;
+
+	return min_t(unsigned long, ra->ra_pages,
+		     max_t(unsigned long, ra->ra_pages >> -ra->ra_shift,
+			   RA_ADAPT_MIN_PAGES));
+}
+
+/*
+ * A sequential reader caught up with a window: after RA_ADAPT_HITS
+ * windows in a row that were as large as allowed, allow a larger one.
+ */
+static void ra_adapt_hit(struct file_ra_state *ra, unsigned long max)
+{
+	if (ra->size < max)
+		return;
+	if (++ra->ra_hits < RA_ADAPT_HITS)
+		return;
+	ra->ra_hits = 0;
+	if (ra->ra_shift < RA_ADAPT_MAX_SHIFT)
+		ra->ra_shift++;
+}
+
+/*
+ * A page of the current window was missing when it was asked for: it has
+ * been reclaimed before it was ever read, so the window was too large.
+ */
+static void ra_adapt_wasted(struct file_ra_state *ra)
+{
+	ra->ra_hits = 0;
+	if (ra->ra_shift > -RA_ADAPT_MIN_SHIFT)
+		ra->ra_shift--;
+}
+#else
+static inline unsigned long ra_adapt_max(struct file_ra_state *ra)
+{
+	return ra->ra_pages;
+}
+
+static inline void ra_adapt_hit(struct file_ra_state *ra, unsigned long max)
+{
+}
+
+static inline void ra_adapt_wasted(struct file_ra_state *ra)
+{
+}
+#endif
+
 /*
  * On-demand readahead design.
  *
@@ -380,10 +444,18 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	struct backing_dev_info *bdi = inode_to_bdi(mapping->host);
-	unsigned long max_pages = ra->ra_pages;
+	unsigned long max_pages;
 	unsigned long add_pages;
 	pgoff_t prev_offset;
 
+	/*
+	 * A synchronous miss inside the last window means readahead pages
+	 * were evicted unused.
+	 */
+	if (!hit_readahead_marker && ra->size && ra_has_index(ra, offset))
+		ra_adapt_wasted(ra);
+	max_pages = ra_adapt_max(ra);
+
 	/*
 	 * If the request exceeds the readahead window, allow the read to
 	 * be up to the optimal hardware IO size
@@ -403,6 +475,8 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		ra_adapt_hit(ra, max_pages);
+		max_pages = ra_adapt_max(ra);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max_pages);
 		ra->async_size = ra->size;
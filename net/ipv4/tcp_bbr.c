@@ -0,0 +1,484 @@
+/*
+ * Bottleneck Bandwidth and RTT (BBR) congestion control
+ *
+ * Instead of treating packet loss as the congestion signal, BBR builds a
+ * model of the path: the bottleneck bandwidth (windowed max of the delivery
+ * rate over the last BBR_BW_RTTS round trips) and the round-trip propagation
+ * delay (windowed min of the RTT over BBR_MIN_RTT_WIN_SEC seconds). It paces
+ * at about the estimated bandwidth and keeps about two BDPs in flight,
+ * periodically probing for more bandwidth (PROBE_BW gain cycling) and for a
+ * lower RTT (PROBE_RTT). This keeps deep (e.g. cellular) buffers from
+ * filling up, and random, non-congestive loss does not collapse the rate.
+ *
+ * Based on the BBR design by Cardwell, Cheng, Gunn, Hassas Yeganeh and
+ * Jacobson ("BBR: Congestion-Based Congestion Control", ACM Queue, 2016).
+ *
+ * Notable differences from that design:
+ *   o There is no per-skb delivery rate sampling here. The delivery rate is
+ *     measured once per round trip, from the packets cumulatively ACKed plus
+ *     the change in SACKed packets over that round.
+ *   o In fast recovery the cwnd is left to PRR; ssthresh is never reduced
+ *     below the model's target, so that amounts to packet conservation.
+ *     After an RTO the cwnd is regrown from what is in flight towards the
+ *     target, and the cwnd from before the loss is restored once the
+ *     connection leaves the Loss state.
+ *   o The pacing rate is enforced by the fq packet scheduler or by TCP
+ *     itself; this module only sets sk_pacing_rate.
+ */
+#include <linux/module.h>
+#include <linux/random.h>
+#include <net/tcp.h>
+
+/* Bandwidth is in packets per usec, scaled by BW_UNIT */
+#define BW_SCALE	24
+#define BW_UNIT		(1 << BW_SCALE)
+
+/* Gains are scaled by BBR_UNIT */
+#define BBR_SCALE	8
+#define BBR_UNIT	(1 << BBR_SCALE)
+
+#define BBR_BW_RTTS		10	/* bandwidth filter window, in rounds */
+#define BBR_MIN_RTT_WIN_SEC	10	/* min_rtt filter window */
+#define BBR_PROBE_RTT_MS	200	/* time spent at BBR_MIN_CWND in PROBE_RTT */
+#define BBR_MIN_CWND		4
+#define BBR_CYCLE_LEN		8	/* phases in a PROBE_BW gain cycle */
+#define BBR_FULL_BW_CNT		3	/* rounds without growth to leave STARTUP */
+
+/* 2/ln(2): the smallest gain that doubles the sending rate each round */
+static const int bbr_high_gain = BBR_UNIT * 2885 / 1000 + 1;
+static const int bbr_drain_gain = BBR_UNIT * 1000 / 2885;
+static const int bbr_cwnd_gain = BBR_UNIT * 2;
+/* Bandwidth must grow by 25% per round to be considered still growing */
+static const u32 bbr_full_bw_thresh = BBR_UNIT * 5 / 4;
+static const int bbr_pacing_gain[BBR_CYCLE_LEN] = {
+	BBR_UNIT * 5 / 4,	/* probe for more available bandwidth */
+	BBR_UNIT * 3 / 4,	/* drain the queue the probe created */
+	BBR_UNIT, BBR_UNIT, BBR_UNIT,
+	BBR_UNIT, BBR_UNIT, BBR_UNIT
+};
+
+enum bbr_mode {
+	BBR_STARTUP,	/* ramp up quickly to fill the pipe */
+	BBR_DRAIN,	/* drain the queue created during startup */
+	BBR_PROBE_BW,	/* cruise at the estimated bandwidth */
+	BBR_PROBE_RTT,	/* cut inflight to refresh min_rtt */
+};
+
+struct bbr_bw_sample {
+	u32	bw;
+	u32	round;
+};
+
+struct bbr {
+	struct bbr_bw_sample bw[3];	/* windowed max, best first */
+	u32	min_rtt_us;
+	u32	min_rtt_stamp;		/* jiffies of the min_rtt sample */
+	u32	next_round_seq;		/* snd_nxt when the round started */
+	u32	round_start_us;
+	u32	acked;			/* packets cumulatively ACKed */
+	u32	round_start_delivered;
+	u32	round_count;
+	u32	full_bw;		/* bandwidth when growth was last seen */
+	u32	mode_stamp;		/* gain cycle phase start or PROBE_RTT end */
+	u16	prior_cwnd;		/* cwnd before PROBE_RTT or loss */
+	u16	mode:2,
+		full_bw_cnt:2,
+		cycle_idx:3,
+		full_bw_reached:1,
+		probe_rtt_started:1,
+		probe_rtt_round_done:1,
+		prev_ca_state:3,	/* icsk_ca_state on the last ACK */
+		unused:3;
+};
+
+static u32 bbr_max_bw(const struct bbr *bbr)
+{
+	return bbr->bw[0].bw;
+}
+
+/* Windowed max of the bandwidth samples over BBR_BW_RTTS rounds, kept as
+ * the best, 2nd best and 3rd best samples of sub-windows (K. Nichols).
+ */
+static void bbr_bw_filter_update(struct bbr *bbr, u32 round, u32 bw)
+{
+	struct bbr_bw_sample s = { .bw = bw, .round = round };
+	u32 dt;
+
+	if (bw >= bbr->bw[0].bw || round - bbr->bw[2].round > BBR_BW_RTTS) {
+		bbr->bw[0] = bbr->bw[1] = bbr->bw[2] = s;
+		return;
+	}
+
+	if (bw >= bbr->bw[1].bw)
+		bbr->bw[2] = bbr->bw[1] = s;
+	else if (bw >= bbr->bw[2].bw)
+		bbr->bw[2] = s;
+
+	dt = round - bbr->bw[0].round;
+	if (dt > BBR_BW_RTTS) {
+		bbr->bw[0] = bbr->bw[1];
+		bbr->bw[1] = bbr->bw[2];
+		bbr->bw[2] = s;
+		if (round - bbr->bw[0].round > BBR_BW_RTTS) {
+			bbr->bw[0] = bbr->bw[1];
+			bbr->bw[1] = bbr->bw[2];
+		}
+	} else if (bbr->bw[1].round == bbr->bw[0].round &&
+		   dt > BBR_BW_RTTS / 4) {
+		bbr->bw[2] = bbr->bw[1] = s;
+	} else if (bbr->bw[2].round == bbr->bw[1].round &&
+		   dt > BBR_BW_RTTS / 2) {
+		bbr->bw[2] = s;
+	}
+}
+
+static int bbr_pacing_gain_now(const struct bbr *bbr)
+{
+	switch (bbr->mode) {
+	case BBR_STARTUP:
+		return bbr_high_gain;
+	case BBR_DRAIN:
+		return bbr_drain_gain;
+	case BBR_PROBE_BW:
+		return bbr_pacing_gain[bbr->cycle_idx];
+	default:
+		return BBR_UNIT;
+	}
+}
+
+static int bbr_cwnd_gain_now(const struct bbr *bbr)
+{
+	switch (bbr->mode) {
+	case BBR_STARTUP:
+	case BBR_DRAIN:
+		return bbr_high_gain;
+	case BBR_PROBE_BW:
+		return bbr_cwnd_gain;
+	default:
+		return BBR_UNIT;
+	}
+}
+
+/* gain * BDP in packets, plus some headroom for delayed and stretched ACKs */
+static u32 bbr_target_cwnd(const struct bbr *bbr, u32 bw, int gain)
+{
+	u64 w;
+	u32 cwnd;
+
+	if (unlikely(bbr->min_rtt_us == ~0U || !bw))
+		return TCP_INIT_CWND;
+
+	w = (u64)bw * bbr->min_rtt_us;
+	cwnd = (((w * gain) >> BBR_SCALE) + BW_UNIT - 1) >> BW_SCALE;
+	cwnd += 3;
+
+	return max_t(u32, cwnd, BBR_MIN_CWND);
+}
+
+static void bbr_set_pacing_rate(struct sock *sk, u32 bw, int gain)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u64 rate = bw;
+
+	rate *= tp->mss_cache;
+	rate = (rate * gain) >> BBR_SCALE;
+	rate = ((rate >> 4) * USEC_PER_SEC) >> (BW_SCALE - 4);
+
+	/* Don't slow down in STARTUP because of a few low samples */
+	if (!bbr->full_bw_reached && rate < sk->sk_pacing_rate)
+		return;
+
+	/* sch_fq fetches sk_pacing_rate without any lock */
+	ACCESS_ONCE(sk->sk_pacing_rate) = min_t(u64, rate,
+						sk->sk_max_pacing_rate);
+}
+
+/* Until the first bandwidth sample, pace the initial cwnd over an RTT */
+static void bbr_init_pacing_rate(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u32 rtt_us = tp->srtt_us ? max(tp->srtt_us >> 3, 1U) : USEC_PER_MSEC;
+	u64 bw = (u64)tp->snd_cwnd * BW_UNIT;
+
+	do_div(bw, rtt_us);
+	sk->sk_pacing_rate = 0;
+	bbr_set_pacing_rate(sk, bw, bbr_high_gain);
+}
+
+static void bbr_save_cwnd(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->prior_cwnd = min_t(u32, max(bbr->prior_cwnd, tp->snd_cwnd),
+				U16_MAX);
+}
+
+static void bbr_enter_probe_bw(struct sock *sk, u32 now_us)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr->mode = BBR_PROBE_BW;
+	/* Start at a random phase, but never in the draining one */
+	bbr->cycle_idx = (2 + prandom_u32_max(BBR_CYCLE_LEN - 1)) &
+			 (BBR_CYCLE_LEN - 1);
+	bbr->mode_stamp = now_us;
+}
+
+static void bbr_advance_cycle(struct sock *sk, u32 now_us, u32 bw)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	int gain = bbr_pacing_gain[bbr->cycle_idx];
+	u32 inflight = tcp_packets_in_flight(tp);
+	bool full_length = now_us - bbr->mode_stamp > bbr->min_rtt_us;
+
+	if (gain > BBR_UNIT) {
+		/* Probe until an RTT has passed and either the queue we hoped
+		 * for has built up, or there is loss.
+		 */
+		if (!full_length || (!tp->lost_out &&
+		     inflight < bbr_target_cwnd(bbr, bw, gain)))
+			return;
+	} else if (gain < BBR_UNIT) {
+		/* Drain until the queue is gone, at most for an RTT */
+		if (!full_length && inflight > bbr_target_cwnd(bbr, bw, BBR_UNIT))
+			return;
+	} else if (!full_length) {
+		return;
+	}
+
+	bbr->cycle_idx = (bbr->cycle_idx + 1) & (BBR_CYCLE_LEN - 1);
+	bbr->mode_stamp = now_us;
+}
+
+/* STARTUP is over when the bandwidth didn't grow for a few rounds */
+static void bbr_check_full_bw_reached(struct sock *sk, u32 bw,
+				      bool app_limited)
+{
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->full_bw_reached || app_limited)
+		return;
+
+	if ((u64)bw * BBR_UNIT >= (u64)bbr->full_bw * bbr_full_bw_thresh) {
+		bbr->full_bw = bw;
+		bbr->full_bw_cnt = 0;
+		return;
+	}
+	if (++bbr->full_bw_cnt >= BBR_FULL_BW_CNT)
+		bbr->full_bw_reached = 1;
+}
+
+static void bbr_update_min_rtt(struct sock *sk, s32 rtt_us, u32 now_us,
+			       bool round_start)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	bool expired = after(tcp_time_stamp, bbr->min_rtt_stamp +
+					     BBR_MIN_RTT_WIN_SEC * HZ);
+
+	if (rtt_us >= 0 && ((u32)rtt_us <= bbr->min_rtt_us || expired)) {
+		bbr->min_rtt_us = max(rtt_us, 1);
+		bbr->min_rtt_stamp = tcp_time_stamp;
+	}
+
+	if (expired && bbr->mode != BBR_PROBE_RTT) {
+		bbr->mode = BBR_PROBE_RTT;
+		bbr->probe_rtt_started = 0;
+		bbr_save_cwnd(sk);
+	}
+
+	if (bbr->mode != BBR_PROBE_RTT)
+		return;
+
+	/* Hold at BBR_MIN_CWND for BBR_PROBE_RTT_MS and at least a round */
+	if (!bbr->probe_rtt_started) {
+		if (tcp_packets_in_flight(tp) <= BBR_MIN_CWND) {
+			bbr->probe_rtt_started = 1;
+			bbr->probe_rtt_round_done = 0;
+			bbr->mode_stamp = now_us + BBR_PROBE_RTT_MS * USEC_PER_MSEC;
+			bbr->next_round_seq = tp->snd_nxt;
+		}
+		return;
+	}
+
+	if (round_start)
+		bbr->probe_rtt_round_done = 1;
+	if (bbr->probe_rtt_round_done && (s32)(now_us - bbr->mode_stamp) > 0) {
+		bbr->min_rtt_stamp = tcp_time_stamp;
+		tp->snd_cwnd = max_t(u32, tp->snd_cwnd, bbr->prior_cwnd);
+		bbr->prior_cwnd = 0;
+		if (bbr->full_bw_reached)
+			bbr_enter_probe_bw(sk, now_us);
+		else
+			bbr->mode = BBR_STARTUP;
+	}
+}
+
+static void bbr_set_cwnd(struct sock *sk, u32 acked, u32 bw)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 target = bbr_target_cwnd(bbr, bw, bbr_cwnd_gain_now(bbr));
+	u32 cwnd = tp->snd_cwnd;
+	u8 state = inet_csk(sk)->icsk_ca_state;
+	u8 prev_state = bbr->prev_ca_state;
+
+	bbr->prev_ca_state = state;
+
+	/* PRR owns the cwnd during fast recovery */
+	if (state == TCP_CA_Recovery)
+		return;
+
+	if (state == TCP_CA_Loss) {
+		/* tcp_enter_loss() dropped the cwnd to 1: send at least as
+		 * much as was just delivered, then grow towards the target.
+		 */
+		cwnd = max(cwnd, tcp_packets_in_flight(tp) + acked);
+	} else if (prev_state >= TCP_CA_Recovery && bbr->prior_cwnd) {
+		/* Loss is not a congestion signal for the model */
+		cwnd = max_t(u32, cwnd, bbr->prior_cwnd);
+		if (bbr->mode != BBR_PROBE_RTT)
+			bbr->prior_cwnd = 0;
+	}
+
+	if (bbr->mode == BBR_PROBE_RTT)
+		cwnd = min_t(u32, cwnd, BBR_MIN_CWND);
+	else if (bbr->full_bw_reached)
+		cwnd = min(cwnd + acked, target);
+	else if (cwnd < target || bbr->acked < TCP_INIT_CWND)
+		cwnd += acked;
+
+	tp->snd_cwnd = min(max_t(u32, cwnd, BBR_MIN_CWND), tp->snd_cwnd_clamp);
+}
+
+static void bbr_acked(struct sock *sk, u32 num_acked, s32 rtt_us)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	struct skb_mstamp now;
+	bool round_start = false;
+	u32 delivered, bw;
+
+	skb_mstamp_get(&now);
+	bbr->acked += num_acked;
+	/* A SACKed packet that gets cumulatively ACKed is counted once */
+	delivered = bbr->acked + tp->sacked_out;
+
+	if (!before(tp->snd_una, bbr->next_round_seq)) {
+		u32 interval = now.stamp_us - bbr->round_start_us;
+		u32 dlv = delivered - bbr->round_start_delivered;
+		bool app_limited = !tcp_send_head(sk) &&
+				   tcp_packets_in_flight(tp) < tp->snd_cwnd;
+
+		if (interval && dlv) {
+			u64 sample = (u64)dlv * BW_UNIT;
+
+			do_div(sample, interval);
+			sample = min_t(u64, sample, U32_MAX);
+			/* An application-limited round says nothing about the
+			 * path, unless it was even faster.
+			 */
+			if (!app_limited || sample >= bbr_max_bw(bbr))
+				bbr_bw_filter_update(bbr, bbr->round_count,
+						     sample);
+		}
+
+		bbr->round_count++;
+		bbr->next_round_seq = tp->snd_nxt;
+		bbr->round_start_us = now.stamp_us;
+		bbr->round_start_delivered = delivered;
+		round_start = true;
+
+		bbr_check_full_bw_reached(sk, bbr_max_bw(bbr), app_limited);
+	}
+
+	bw = bbr_max_bw(bbr);
+
+	if (bbr->mode == BBR_STARTUP && bbr->full_bw_reached)
+		bbr->mode = BBR_DRAIN;
+	if (bbr->mode == BBR_DRAIN &&
+	    tcp_packets_in_flight(tp) <= bbr_target_cwnd(bbr, bw, BBR_UNIT))
+		bbr_enter_probe_bw(sk, now.stamp_us);
+	if (bbr->mode == BBR_PROBE_BW)
+		bbr_advance_cycle(sk, now.stamp_us, bw);
+
+	bbr_update_min_rtt(sk, rtt_us, now.stamp_us, round_start);
+
+	if (bw)
+		bbr_set_pacing_rate(sk, bw, bbr_pacing_gain_now(bbr));
+	bbr_set_cwnd(sk, num_acked, bw);
+}
+
+/* The cwnd is set from bbr_acked() on every ACK */
+static void bbr_cong_avoid(struct sock *sk, u32 ack, u32 acked)
+{
+}
+
+/* Loss is not a congestion signal for the model. Keep ssthresh at or above
+ * the target, so that recovery does not shrink the cwnd below it.
+ */
+static u32 bbr_ssthresh(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+
+	bbr_save_cwnd(sk);
+	return max(tp->snd_cwnd,
+		   bbr_target_cwnd(bbr, bbr_max_bw(bbr), bbr_cwnd_gain));
+}
+
+static u32 bbr_undo_cwnd(struct sock *sk)
+{
+	return tcp_sk(sk)->snd_cwnd;
+}
+
+static void bbr_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	struct skb_mstamp now;
+
+	skb_mstamp_get(&now);
+	memset(bbr, 0, sizeof(*bbr));
+	bbr->min_rtt_us = tp->srtt_us ? max(tp->srtt_us >> 3, 1U) : ~0U;
+	bbr->min_rtt_stamp = tcp_time_stamp;
+	bbr->next_round_seq = tp->snd_nxt;
+	bbr->round_start_us = now.stamp_us;
+	bbr->mode = BBR_STARTUP;
+
+	bbr_init_pacing_rate(sk);
+
+	/* Without sch_fq on the way out, pace from TCP itself */
+	cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
+}
+
+static struct tcp_congestion_ops tcp_bbr_cong_ops __read_mostly = {
+	.flags		= TCP_CONG_OWN_PACING,
+	.init		= bbr_init,
+	.ssthresh	= bbr_ssthresh,
+	.cong_avoid	= bbr_cong_avoid,
+	.undo_cwnd	= bbr_undo_cwnd,
+	.pkts_acked	= bbr_acked,
+	.owner		= THIS_MODULE,
+	.name		= "bbr",
+};
+
+static int __init bbr_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct bbr) > ICSK_CA_PRIV_SIZE);
+	return tcp_register_congestion_control(&tcp_bbr_cong_ops);
+}
+
+static void __exit bbr_unregister(void)
+{
+	tcp_unregister_congestion_control(&tcp_bbr_cong_ops);
+}
+
+module_init(bbr_register);
+module_exit(bbr_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("TCP BBR (Bottleneck Bandwidth and RTT)");
@@ -1169,6 +1169,9 @@ static void tcp_update_pacing_rate(struct sock *sk)
 	const struct tcp_sock *tp = tcp_sk(sk);
 	u64 rate;
 
+	if (inet_csk(sk)->icsk_ca_ops->flags & TCP_CONG_OWN_PACING)
+		return;
+
 	/* set sk_pacing_rate to 200 % of current rate (mss * cwnd / srtt) */
 	rate = (u64)tp->mss_cache * ((USEC_PER_SEC / 100) << 3);
 
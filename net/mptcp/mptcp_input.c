@@ -998,10 +998,6 @@ static int mptcp_queue_skb(struct sock *sk)
 			if (TCP_SKB_CB(tmp1)->tcp_flags & TCPHDR_FIN)
 				mptcp_fin(meta_sk);
 
-			/* Check if this fills a gap in the ofo queue */
-			if (!RB_EMPTY_ROOT(&meta_tp->out_of_order_queue))
-				tcp_ofo_queue(meta_sk);
-
 			if (eaten)
 				kfree_skb_partial(tmp1, fragstolen);
 
@@ -1012,6 +1008,13 @@ next:
 				    tp->mptcp->map_subseq + tp->mptcp->map_data_len))
 				break;
 		}
+
+		/* The segments of a mapping are contiguous, so nothing from the
+		 * ofo queue can go in between them. Check only once whether the
+		 * whole batch filled a gap.
+		 */
+		if (data_queued && !RB_EMPTY_ROOT(&meta_tp->out_of_order_queue))
+			tcp_ofo_queue(meta_sk);
 	}
 
 	inet_csk(meta_sk)->icsk_ack.lrcvtime = tcp_time_stamp;
@@ -0,0 +1,184 @@
+/* MPTCP latency-aware scheduler
+ *
+ * Instead of taking the subflow with the lowest sRTT, estimate for every
+ * active subflow when the segment would reach the receiver: the rounds it
+ * has to wait behind data already queued/in flight on that subflow, plus
+ * the RTT variance and the expected cost of a loss there. The segment goes
+ * to the subflow with the earliest estimate - even if that means waiting
+ * for cwnd space on a fast path rather than sending on a slow, jittery one
+ * and stalling the receiver's reordering queue.
+ */
+
+#include <linux/module.h>
+#include <net/mptcp.h>
+
+static unsigned char jitter_weight __read_mostly = 2;
+module_param(jitter_weight, byte, 0644);
+MODULE_PARM_DESC(jitter_weight, "Number of RTT mean deviations added to the arrival estimate");
+
+static unsigned char wait_margin __read_mostly = 25;
+module_param(wait_margin, byte, 0644);
+MODULE_PARM_DESC(wait_margin, "Percentage by which a cwnd-limited subflow must be earlier before we wait for it");
+
+/* Loss-rate is kept as a fraction of LATSCHED_LOSS_ONE */
+#define LATSCHED_LOSS_SHIFT	10
+#define LATSCHED_LOSS_ONE	(1U << LATSCHED_LOSS_SHIFT)
+/* Minimum number of segments sent before taking a new loss sample */
+#define LATSCHED_LOSS_SEGS	16
+
+struct latsched_priv {
+	u32	last_rbuf_opti;	/* Used by mptcp_next_segment(), keep first */
+	u32	last_segs_out;
+	u32	last_retrans;
+	u16	loss;
+};
+
+static struct latsched_priv *latsched_get_priv(const struct tcp_sock *tp)
+{
+	return (struct latsched_priv *)&tp->mptcp->mptcp_sched[0];
+}
+
+/* EWMA (1/8) of the retransmitted fraction of the segments sent */
+static void latsched_update_loss(const struct tcp_sock *tp)
+{
+	struct latsched_priv *lsp = latsched_get_priv(tp);
+	u32 segs = tp->segs_out - lsp->last_segs_out;
+	u32 lost = tp->total_retrans - lsp->last_retrans;
+	u32 sample;
+
+	if (segs < LATSCHED_LOSS_SEGS)
+		return;
+
+	sample = min_t(u32, (lost << LATSCHED_LOSS_SHIFT) / segs,
+		       LATSCHED_LOSS_ONE);
+	lsp->loss = lsp->loss - (lsp->loss >> 3) + (sample >> 3);
+
+	lsp->last_segs_out = tp->segs_out;
+	lsp->last_retrans = tp->total_retrans;
+}
+
+/* Estimated time (in usecs, relative) until skb is received when sent
+ * on sk.
+ */
+static u64 latsched_arrival(struct sock *sk, const struct sk_buff *skb)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct latsched_priv *lsp = latsched_get_priv(tp);
+	u32 srtt = tp->srtt_us >> 3;
+	u32 space = max(tp->snd_cwnd, 1U) * tp->mss_cache;
+	u32 queued = tp->write_seq - tp->snd_una;
+	u64 arrival;
+
+	/* Full rounds spent behind what is already on this subflow */
+	arrival = (u64)srtt * ((queued + skb->len - 1) / space);
+	/* plus the one-way delay of our own round */
+	arrival += srtt >> 1;
+	arrival += (u64)jitter_weight * (tp->mdev_us >> 2);
+	arrival += ((u64)lsp->loss *
+		    jiffies_to_usecs(inet_csk(sk)->icsk_rto)) >> LATSCHED_LOSS_SHIFT;
+
+	return arrival;
+}
+
+/* Is sk only held back by its cwnd/window, so that it will become available
+ * again as soon as acks come in?
+ */
+static bool latsched_may_wait(const struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+
+	return inet_csk(sk)->icsk_ca_state != TCP_CA_Loss &&
+	       tp->mptcp->fully_established &&
+	       !test_bit(TSQ_THROTTLED, &tp->tsq_flags);
+}
+
+static struct sock *latsched_get_subflow(struct sock *meta_sk,
+					 struct sk_buff *skb,
+					 bool zero_wnd_test)
+{
+	struct mptcp_cb *mpcb = tcp_sk(meta_sk)->mpcb;
+	struct sock *sk, *bestsk = NULL, *availsk;
+	u64 best = U64_MAX, avail;
+
+	availsk = get_available_subflow(meta_sk, skb, zero_wnd_test);
+
+	/* Leave the special cases to the default scheduler: a single subflow,
+	 * window probes, reinjections and only backup subflows left.
+	 */
+	if (mpcb->cnt_subflows == 1 || !skb || TCP_SKB_CB(skb)->path_mask ||
+	    !availsk || subflow_is_backup(tcp_sk(availsk)) ||
+	    (meta_sk->sk_shutdown & RCV_SHUTDOWN && mptcp_is_data_fin(skb)))
+		return availsk;
+
+	mptcp_for_each_sk(mpcb, sk) {
+		struct tcp_sock *tp = tcp_sk(sk);
+		u64 arrival;
+
+		if (!subflow_is_active(tp) || mptcp_is_def_unavailable(sk))
+			continue;
+
+		latsched_update_loss(tp);
+		arrival = latsched_arrival(sk, skb);
+		if (arrival < best) {
+			best = arrival;
+			bestsk = sk;
+		}
+	}
+
+	if (!bestsk || bestsk == availsk ||
+	    mptcp_is_available(bestsk, skb, zero_wnd_test))
+		return bestsk ? : availsk;
+
+	if (!latsched_may_wait(bestsk))
+		return availsk;
+
+	/* The earliest subflow is cwnd-limited. Only hold the segment back
+	 * if it is clearly better than what we could send on right now.
+	 */
+	avail = latsched_arrival(availsk, skb);
+	if (best + div_u64(best * wait_margin, 100) < avail)
+		return NULL;
+
+	return availsk;
+}
+
+static void latsched_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct latsched_priv *lsp = latsched_get_priv(tp);
+
+	lsp->last_rbuf_opti = tcp_time_stamp;
+	lsp->last_segs_out = tp->segs_out;
+	lsp->last_retrans = tp->total_retrans;
+	lsp->loss = 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_latency = {
+	.get_subflow = latsched_get_subflow,
+	.next_segment = mptcp_next_segment,
+	.init = latsched_init,
+	.name = "latency",
+	.owner = THIS_MODULE,
+};
+
+static int __init latsched_register(void)
+{
+	BUILD_BUG_ON(sizeof(struct latsched_priv) > MPTCP_SCHED_SIZE);
+
+	if (mptcp_register_scheduler(&mptcp_sched_latency))
+		return -1;
+
+	return 0;
+}
+
+static void latsched_unregister(void)
+{
+	mptcp_unregister_scheduler(&mptcp_sched_latency);
+}
+
+module_init(latsched_register);
+module_exit(latsched_unregister);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Latency-aware MPTCP scheduler");
+MODULE_VERSION("0.89");
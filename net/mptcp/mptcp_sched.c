@@ -384,10 +384,14 @@ static struct sk_buff *__mptcp_next_segment(struct sock *meta_sk, int *reinject)
 	return skb;
 }
 
-static struct sk_buff *mptcp_next_segment(struct sock *meta_sk,
-					  int *reinject,
-					  struct sock **subsk,
-					  unsigned int *limit)
+/* Schedulers that only differ in the subflow selection can use this as
+ * their next_segment. Their private data then has to start with the u32
+ * that mptcp_rcv_buf_optimization() uses, like struct defsched_priv.
+ */
+struct sk_buff *mptcp_next_segment(struct sock *meta_sk,
+				   int *reinject,
+				   struct sock **subsk,
+				   unsigned int *limit)
 {
 	struct sk_buff *skb = __mptcp_next_segment(meta_sk, reinject);
 	unsigned int mss_now;
@@ -401,7 +405,8 @@ static struct sk_buff *mptcp_next_segment(struct sock *meta_sk,
 	if (!skb)
 		return NULL;
 
-	*subsk = get_available_subflow(meta_sk, skb, false);
+	*subsk = tcp_sk(meta_sk)->mpcb->sched_ops->get_subflow(meta_sk, skb,
+								false);
 	if (!*subsk)
 		return NULL;
 
@@ -448,6 +453,7 @@ static struct sk_buff *mptcp_next_segment(struct sock *meta_sk,
 
 	return skb;
 }
+EXPORT_SYMBOL_GPL(mptcp_next_segment);
 
 static void defsched_init(struct sock *sk)
 {
@@ -29,6 +29,10 @@
 #include <linux/xattr.h>
 #include <linux/fs.h>
 #include <linux/proca.h>
+#ifdef CONFIG_PROCA_DEBUG
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#endif
 
 #include "proca_porting.h"
 
@@ -420,6 +424,39 @@ int proca_get_task_cert(const struct task_struct *task,
 	return 0;
 }
 
+#ifdef CONFIG_PROCA_DEBUG
+static int proca_table_stats_show(struct seq_file *m, void *v)
+{
+	struct proca_table_stats stats;
+
+	proca_table_get_stats(&g_proca_table, &stats);
+	seq_printf(m, "hits: %lu\nmisses: %lu\n", stats.hits, stats.misses);
+	return 0;
+}
+
+static int proca_table_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proca_table_stats_show, NULL);
+}
+
+static const struct file_operations proca_table_stats_fops = {
+	.open = proca_table_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void proca_create_debugfs(void)
+{
+	debugfs_create_file("proca_table_stats", 0400, NULL, NULL,
+			    &proca_table_stats_fops);
+}
+#else
+static inline void proca_create_debugfs(void)
+{
+}
+#endif
+
 static __init int proca_module_init(void)
 {
 	int ret;
@@ -433,6 +470,7 @@ static __init int proca_module_init(void)
 		return ret;
 
 	proca_table_init(&g_proca_table);
+	proca_create_debugfs();
 
 	security_add_hooks(proca_ops, ARRAY_SIZE(proca_ops), "proca_lsm");
 	five_add_hooks(five_ops, ARRAY_SIZE(five_ops));
@@ -17,19 +17,34 @@
 #include "proca_table.h"
 
 #include <linux/hashtable.h>
+#include <linux/percpu.h>
+#include <linux/rculist.h>
 #include <linux/string.h>
 
 void proca_table_init(struct proca_table *table)
 {
+	int i;
+
 	memset(table, 0, sizeof(*table));
 
-	spin_lock_init(&table->pid_map_lock);
+	for (i = 0; i < ARRAY_SIZE(table->pid_map_locks); ++i)
+		spin_lock_init(&table->pid_map_locks[i]);
 	hash_init(table->pid_map);
 
-	spin_lock_init(&table->app_name_map_lock);
+	for (i = 0; i < ARRAY_SIZE(table->app_name_map_locks); ++i)
+		spin_lock_init(&table->app_name_map_locks[i]);
 	hash_init(table->app_name_map);
 
 	table->hash_tables_shift = PROCA_TASKS_TABLE_SHIFT;
+
+	/* Statistics are optional, lookups work without them */
+	table->stats = alloc_percpu(struct proca_table_stats);
+}
+
+static inline spinlock_t *bucket_lock(spinlock_t *locks,
+				      unsigned long hash_key)
+{
+	return &locks[hash_key & ((1 << PROCA_TABLE_LOCKS_SHIFT) - 1)];
 }
 
 /*
@@ -89,40 +104,53 @@ void proca_table_add_task_descr(struct proca_table *table,
 {
 	unsigned long hash_key;
 	unsigned long irqsave_flags;
+	spinlock_t *lock;
 
 	hash_key = calculate_pid_hash(table, descr->task->pid);
-	spin_lock_irqsave(&table->pid_map_lock, irqsave_flags);
-	hlist_add_head(&descr->pid_map_node,
+	descr->pid_map_key = hash_key;
+	lock = bucket_lock(table->pid_map_locks, hash_key);
+	spin_lock_irqsave(lock, irqsave_flags);
+	hlist_add_head_rcu(&descr->pid_map_node,
 		       &table->pid_map[hash_key]);
-	spin_unlock_irqrestore(&table->pid_map_lock, irqsave_flags);
+	spin_unlock_irqrestore(lock, irqsave_flags);
 
 	if (descr->proca_identity.certificate) {
 		hash_key = calculate_app_name_hash(table,
 			descr->proca_identity.parsed_cert.app_name,
 			descr->proca_identity.parsed_cert.app_name_size);
-		spin_lock_irqsave(&table->app_name_map_lock, irqsave_flags);
-		hlist_add_head(&descr->app_name_map_node,
+		lock = bucket_lock(table->app_name_map_locks, hash_key);
+		spin_lock_irqsave(lock, irqsave_flags);
+		hlist_add_head_rcu(&descr->app_name_map_node,
 			&table->app_name_map[hash_key]);
-		spin_unlock_irqrestore(
-			&table->app_name_map_lock, irqsave_flags);
+		spin_unlock_irqrestore(lock, irqsave_flags);
 	}
 }
 
 void proca_table_remove_task_descr(struct proca_table *table,
 				struct proca_task_descr *descr)
 {
+	unsigned long hash_key;
 	unsigned long irqsave_flags;
+	spinlock_t *lock;
 
 	if (!descr)
 		return;
 
-	spin_lock_irqsave(&table->pid_map_lock, irqsave_flags);
-	hash_del(&descr->pid_map_node);
-	spin_unlock_irqrestore(&table->pid_map_lock, irqsave_flags);
+	/* The pid may have changed in de_thread() since the descr was added */
+	lock = bucket_lock(table->pid_map_locks, descr->pid_map_key);
+	spin_lock_irqsave(lock, irqsave_flags);
+	hash_del_rcu(&descr->pid_map_node);
+	spin_unlock_irqrestore(lock, irqsave_flags);
 
-	spin_lock_irqsave(&table->app_name_map_lock, irqsave_flags);
-	hash_del(&descr->app_name_map_node);
-	spin_unlock_irqrestore(&table->app_name_map_lock, irqsave_flags);
+	if (descr->proca_identity.certificate) {
+		hash_key = calculate_app_name_hash(table,
+			descr->proca_identity.parsed_cert.app_name,
+			descr->proca_identity.parsed_cert.app_name_size);
+		lock = bucket_lock(table->app_name_map_locks, hash_key);
+		spin_lock_irqsave(lock, irqsave_flags);
+		hash_del_rcu(&descr->app_name_map_node);
+		spin_unlock_irqrestore(lock, irqsave_flags);
+	}
 }
 
 struct proca_task_descr *proca_table_get_by_task(
@@ -132,22 +160,46 @@ struct proca_task_descr *proca_table_get_by_task(
 	struct proca_task_descr *descr;
 	struct proca_task_descr *target_task_descr = NULL;
 	unsigned long hash_key;
-	unsigned long irqsave_flags;
 
 	hash_key = calculate_pid_hash(table, task->pid);
 
-	spin_lock_irqsave(&table->pid_map_lock, irqsave_flags);
-	hlist_for_each_entry(descr, &table->pid_map[hash_key], pid_map_node) {
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(descr, &table->pid_map[hash_key],
+				 pid_map_node) {
 		if (task == descr->task) {
 			target_task_descr = descr;
 			break;
 		}
 	}
-	spin_unlock_irqrestore(&table->pid_map_lock, irqsave_flags);
+	rcu_read_unlock();
+
+	if (table->stats) {
+		if (target_task_descr)
+			this_cpu_inc(table->stats->hits);
+		else
+			this_cpu_inc(table->stats->misses);
+	}
 
 	return target_task_descr;
 }
 
+void proca_table_get_stats(struct proca_table *table,
+			   struct proca_table_stats *stats)
+{
+	struct proca_table_stats *cpu_stats;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!table->stats)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		cpu_stats = per_cpu_ptr(table->stats, cpu);
+		stats->hits += cpu_stats->hits;
+		stats->misses += cpu_stats->misses;
+	}
+}
+
 struct proca_task_descr *proca_table_remove_by_task(
 				struct proca_table *table,
 				const struct task_struct *task)
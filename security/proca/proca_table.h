@@ -23,15 +23,27 @@
 #include "proca_task_descr.h"
 
 #define PROCA_TASKS_TABLE_SHIFT 10
+#define PROCA_TABLE_LOCKS_SHIFT 6
 
+struct proca_table_stats {
+	unsigned long hits;
+	unsigned long misses;
+};
+
+/*
+ * Lookups walk the buckets under RCU. Writers serialize on a lock
+ * picked by the bucket index.
+ */
 struct proca_table {
 	unsigned int hash_tables_shift;
 
 	DECLARE_HASHTABLE(pid_map, PROCA_TASKS_TABLE_SHIFT);
-	spinlock_t pid_map_lock;
+	spinlock_t pid_map_locks[1 << PROCA_TABLE_LOCKS_SHIFT];
 
 	DECLARE_HASHTABLE(app_name_map, PROCA_TASKS_TABLE_SHIFT);
-	spinlock_t app_name_map_lock;
+	spinlock_t app_name_map_locks[1 << PROCA_TABLE_LOCKS_SHIFT];
+
+	struct proca_table_stats __percpu *stats;
 };
 
 void proca_table_init(struct proca_table *table);
@@ -49,4 +61,7 @@ struct proca_task_descr *proca_table_remove_by_task(
 
 void proca_table_remove_task_descr(struct proca_table *table,
 				   struct proca_task_descr *descr);
+
+void proca_table_get_stats(struct proca_table *table,
+			   struct proca_table_stats *stats);
 #endif //_LINUX_PROCA_TABLE_H
@@ -48,5 +48,6 @@ void destroy_proca_task_descr(struct proca_task_descr *proca_task_descr)
 	PROCA_DEBUG_LOG("Destroying proca task descriptor for task %d\n",
 			proca_task_descr->task->pid);
 	deinit_proca_identity(&proca_task_descr->proca_identity);
-	kfree(proca_task_descr);
+	/* The table may still be walked by a lockless lookup */
+	kfree_rcu(proca_task_descr, rcu);
 }
@@ -28,6 +28,8 @@ struct proca_task_descr {
 	struct proca_identity proca_identity;
 	struct hlist_node pid_map_node;
 	struct hlist_node app_name_map_node;
+	unsigned long pid_map_key;
+	struct rcu_head rcu;
 };
 
 struct proca_task_descr *create_proca_task_descr(struct task_struct *task,
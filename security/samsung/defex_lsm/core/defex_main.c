@@ -170,10 +170,10 @@ __visible_for_testing int task_defex_is_secured(struct defex_context *dc)
 {
 	struct file *exe_file = get_dc_process_file(dc);
 	struct task_struct *p = dc->task->group_leader;
-	char *proc_name = get_dc_process_name(dc);
+	const struct path *dpath = get_dc_process_dpath(dc);
 	int is_secured = 1;
 
-	if (!get_dc_process_dpath(dc))
+	if (!dpath)
 		return is_secured;
 
 	if (!strncmp(p->comm, "system_server",  strlen(p->comm))) {
@@ -185,7 +185,7 @@ __visible_for_testing int task_defex_is_secured(struct defex_context *dc)
 		return DEFEX_ALLOW;
 	}
 
-	is_secured = !rules_lookup2(proc_name, feature_ped_exception, exe_file);
+	is_secured = !rules_lookup(dpath, feature_ped_exception, exe_file);
 	return is_secured;
 }
 
@@ -405,8 +405,7 @@ __visible_for_testing int task_defex_safeplace(struct defex_context *dc)
 	if (!get_dc_target_dpath(dc))
 		goto out;
 
-	new_file = get_dc_target_name(dc);
-	is_violation = rules_lookup2(new_file, feature_safeplace_path, dc->target_file);
+	is_violation = rules_lookup(get_dc_target_dpath(dc), feature_safeplace_path, dc->target_file);
 #ifdef DEFEX_INTEGRITY_ENABLE
 	if (is_violation != DEFEX_INTEGRITY_FAIL)
 #endif /* DEFEX_INTEGRITY_ENABLE */
@@ -415,6 +414,7 @@ __visible_for_testing int task_defex_safeplace(struct defex_context *dc)
 	if (is_violation) {
 		ret = -DEFEX_DENY;
 		proc_file = get_dc_process_name(dc);
+		new_file = get_dc_target_name(dc);
 
 #ifdef DEFEX_INTEGRITY_ENABLE
 		if (is_violation == DEFEX_INTEGRITY_FAIL) {
@@ -450,14 +450,14 @@ out:
 __visible_for_testing int task_defex_src_exception(struct defex_context *dc)
 {
 	struct file *exe_file = get_dc_process_file(dc);
-	char *proc_name = get_dc_process_name(dc);
+	const struct path *dpath = get_dc_process_dpath(dc);
 	int allow = 1;
 
-	if (!get_dc_process_dpath(dc))
+	if (!dpath)
 		return allow;
 
 	exe_file = get_dc_process_file(dc);
-	allow = rules_lookup2(proc_name, feature_immutable_src_exception, exe_file);
+	allow = rules_lookup(dpath, feature_immutable_src_exception, exe_file);
 	return allow;
 }
 
@@ -471,8 +471,7 @@ __visible_for_testing int task_defex_immutable(struct defex_context *dc, int att
 	if (!get_dc_target_dpath(dc))
 		goto out;
 
-	new_file = get_dc_target_name(dc);
-	is_violation = rules_lookup2(new_file, attribute, dc->target_file);
+	is_violation = rules_lookup(get_dc_target_dpath(dc), attribute, dc->target_file);
 
 	if (is_violation) {
 		/* Check the Source exception and self-access */
@@ -483,6 +482,7 @@ __visible_for_testing int task_defex_immutable(struct defex_context *dc, int att
 
 		ret = -DEFEX_DENY;
 		proc_file = get_dc_process_name(dc);
+		new_file = get_dc_target_name(dc);
 		pr_crit("defex: immutable %s violation [task=%s (%s), access to:%s]\n",
 			(attribute==feature_immutable_path_open)?"open":"write", p->comm, proc_file, new_file);
 #ifdef DEFEX_DSMS_ENABLE
@@ -11,11 +11,14 @@
 #include <linux/fcntl.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/fs_struct.h>
 #include <linux/init.h>
 #include <linux/initrd.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/kobject.h>
+#include <linux/mount.h>
+#include <linux/namei.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
@@ -23,6 +26,7 @@
 #include <linux/sysfs.h>
 #include <linux/time.h>
 #include <linux/version.h>
+#include "../fs/mount.h"
 #include "include/defex_debug.h"
 #include "include/defex_internal.h"
 #include "include/defex_rules.h"
@@ -252,35 +256,50 @@ __visible_for_testing int defex_integrity_default(const char *file_path)
 #endif /* DEFEX_INTEGRITY_ENABLE */
 
 #ifdef DEFEX_USE_PACKED_RULES
+/* The rules compiler orders each sibling list by (size, name) */
+static inline int rules_tree_sorted(void)
+{
+	struct rule_item_struct *base = (struct rule_item_struct *)defex_packed_rules;
+
+	return (base->size == DEFEX_RULES_TAG_LEN
+		&& !memcmp(base->name, DEFEX_RULES_SORTED_TAG, DEFEX_RULES_TAG_LEN));
+}
+
 __visible_for_testing struct rule_item_struct *lookup_dir(struct rule_item_struct *base, const char *name, int l, int for_recovery)
 {
 	struct rule_item_struct *item = NULL;
 	unsigned int offset;
+	int sorted, cmp;
 
 	if (!base || !base->next_level)
 		return item;
+	sorted = rules_tree_sorted();
 	item = GET_ITEM_PTR(base->next_level);
 	do {
-		if ((!(item->feature_type & feature_is_file)
-			|| (!!(item->feature_type & feature_for_recovery)) == for_recovery)
-			&& item->size == l
-			&& !memcmp(name, item->name, l)) return item;
+		if (item->size == l) {
+			cmp = memcmp(item->name, name, l);
+			if (!cmp && (!(item->feature_type & feature_is_file)
+				|| (!!(item->feature_type & feature_for_recovery)) == for_recovery))
+				return item;
+			/* Sorted list: all remaining names are greater */
+			if (sorted && cmp > 0)
+				break;
+		} else if (sorted && item->size > l) {
+			break;
+		}
 		offset = item->next_file;
 		item = GET_ITEM_PTR(offset);
 	} while(offset);
 	return NULL;
 }
 
-__visible_for_testing int lookup_tree(const char *file_path, int attribute, struct file *f)
+/* Returns the packed rules tree or NULL with the verdict to use in *res */
+__visible_for_testing struct rule_item_struct *rules_tree_base(int attribute, int *res)
 {
-	const char *ptr, *next_separator;
-	struct rule_item_struct *base, *cur_item = NULL;
+	struct rule_item_struct *base;
+#ifdef DEFEX_KERNEL_ONLY
 	int l;
 
-	if (!file_path || *file_path != '/')
-		return 0;
-
-#ifdef DEFEX_KERNEL_ONLY
 try_to_load:
 #endif
 	base = (struct rule_item_struct *)defex_packed_rules;
@@ -290,13 +309,56 @@ try_to_load:
 		l = load_rules_late();
 		if (l > 0)
 			goto try_to_load;
-		if (!l || is_recovery)
-			return (attribute == feature_ped_exception || attribute == feature_safeplace_path)?1:0;
+		if (!l || is_recovery) {
+			*res = (attribute == feature_ped_exception || attribute == feature_safeplace_path)?1:0;
+			return NULL;
+		}
 #endif /* DEFEX_KERNEL_ONLY */
 		/* block all requests if rules were not loaded instead */
-		return 0;
+		*res = 0;
+		return NULL;
+	}
+	return base;
+}
+
+/* Verdict for an item matched on the walk, -1 to go to the next level */
+__visible_for_testing int lookup_item_verdict(struct rule_item_struct *item, int attribute,
+	struct file *f, int is_last, int check_integrity)
+{
+	if (!(item->feature_type & attribute))
+		return -1;
+#ifdef DEFEX_INTEGRITY_ENABLE
+	/* Integrity acceptable only for files */
+	if ((item->feature_type & feature_is_file) && f) {
+		if (check_integrity && defex_check_integrity(f, item->integrity))
+			return DEFEX_INTEGRITY_FAIL;
 	}
+#endif /* DEFEX_INTEGRITY_ENABLE */
+	if (attribute & (feature_immutable_path_open | feature_immutable_path_write)
+		&& !(item->feature_type & feature_is_file)) {
+		/* Allow open the folder by default */
+		if (is_last)
+			return 0;
+	}
+	return 1;
+}
 
+__visible_for_testing int lookup_tree(const char *file_path, int attribute, struct file *f)
+{
+	const char *ptr, *next_separator;
+	struct rule_item_struct *base, *cur_item = NULL;
+	int l, res = 0, check_integrity = 0;
+
+	if (!file_path || *file_path != '/')
+		return 0;
+
+	base = rules_tree_base(attribute, &res);
+	if (!base)
+		return res;
+
+#ifdef DEFEX_INTEGRITY_ENABLE
+	check_integrity = defex_integrity_default(file_path);
+#endif /* DEFEX_INTEGRITY_ENABLE */
 	ptr = file_path + 1;
 	do {
 		next_separator = strchr(ptr, '/');
@@ -312,23 +374,10 @@ try_to_load:
 
 		if (!cur_item)
 			break;
-		if (cur_item->feature_type & attribute) {
-#ifdef DEFEX_INTEGRITY_ENABLE
-			/* Integrity acceptable only for files */
-			if ((cur_item->feature_type & feature_is_file) && f) {
-				if (defex_integrity_default(file_path)
-					&& defex_check_integrity(f, cur_item->integrity))
-					return DEFEX_INTEGRITY_FAIL;
-			}
-#endif /* DEFEX_INTEGRITY_ENABLE */
-			if (attribute & (feature_immutable_path_open | feature_immutable_path_write)
-				&& !(cur_item->feature_type & feature_is_file)) {
-				/* Allow open the folder by default */
-				if (!next_separator || *(ptr + l + 1) == 0)
-					return 0;
-			}
-			return 1;
-		}
+		res = lookup_item_verdict(cur_item, attribute, f,
+			!next_separator || *(ptr + l + 1) == 0, check_integrity);
+		if (res >= 0)
+			return res;
 		base = cur_item;
 		ptr += l;
 		if (next_separator)
@@ -336,6 +385,177 @@ try_to_load:
 	} while(*ptr);
 	return 0;
 }
+
+/*
+ * Collect the dentries of dpath, leaf first, up to root, the way
+ * prepend_path() does: no references are taken, so the caller must hold
+ * rcu_read_lock() and check rename_lock and mount_lock afterwards.
+ * Returns the depth or -1 when the path can not be walked this way (too
+ * deep, disconnected).
+ */
+__visible_for_testing int path_components(const struct path *dpath,
+	const struct path *root, struct dentry **comp)
+{
+	struct dentry *dentry = dpath->dentry;
+	struct vfsmount *vfsmnt = dpath->mnt;
+	struct mount *mnt = real_mount(vfsmnt);
+	int depth = 0;
+
+	while (dentry != root->dentry || vfsmnt != root->mnt) {
+		if (dentry == vfsmnt->mnt_root || IS_ROOT(dentry)) {
+			struct mount *parent = ACCESS_ONCE(mnt->mnt_parent);
+
+			/* Escaped? */
+			if (dentry != vfsmnt->mnt_root)
+				return -1;
+			/* Global root? */
+			if (mnt == parent)
+				break;
+			dentry = ACCESS_ONCE(mnt->mnt_mountpoint);
+			mnt = parent;
+#ifdef CONFIG_RKP_NS_PROT
+			vfsmnt = mnt->mnt;
+#else
+			vfsmnt = &mnt->mnt;
+#endif
+			continue;
+		}
+		if (depth == DEFEX_MAX_PATH_DEPTH)
+			return -1;
+		comp[depth++] = dentry;
+		dentry = ACCESS_ONCE(dentry->d_parent);
+	}
+	return depth;
+}
+
+/*
+ * Snapshot of a dentry name under RCU, as prepend_name() takes it.  The
+ * length is bounded by the terminating NUL in case name and len belong to
+ * different renames; the rename_lock check then discards the result.
+ */
+static int dentry_name_snapshot(struct dentry *dentry, const char **name)
+{
+	const char *dname = ACCESS_ONCE(dentry->d_name.name);
+	u32 dlen = ACCESS_ONCE(dentry->d_name.len);
+
+	smp_read_barrier_depends();
+	*name = dname;
+	return strnlen(dname, dlen);
+}
+
+static struct rule_item_struct *lookup_dentry(struct rule_item_struct *base, struct dentry *dentry)
+{
+	struct rule_item_struct *item;
+	const char *name;
+	int l;
+
+	l = dentry_name_snapshot(dentry, &name);
+	item = lookup_dir(base, name, l, is_recovery);
+	if (!item)
+		item = lookup_dir(base, name, l, !is_recovery);
+	return item;
+}
+
+static int dentry_name_is(struct dentry *dentry, const char *name)
+{
+	const char *dname;
+	int l = dentry_name_snapshot(dentry, &dname);
+
+	return l == strlen(name) && !memcmp(dname, name, l);
+}
+
+#ifdef DEFEX_INTEGRITY_ENABLE
+/* Do comp[top..0] spell exactly names[0..count - 1]? */
+static int components_are(struct dentry **comp, int top, const char * const *names, int count)
+{
+	if (top != count - 1)
+		return 0;
+	for (; top >= 0; top--) {
+		if (!dentry_name_is(comp[top], names[count - 1 - top]))
+			return 0;
+	}
+	return 1;
+}
+#endif /* DEFEX_INTEGRITY_ENABLE */
+
+static void defex_get_fs_root_rcu(struct fs_struct *fs, struct path *root)
+{
+	unsigned seq;
+
+	do {
+		seq = read_seqcount_begin(&fs->seq);
+		*root = fs->root;
+	} while (read_seqcount_retry(&fs->seq, seq));
+}
+
+/*
+ * Same walk as lookup_tree(), driven by the dentry chain instead of d_path().
+ * The rule items are matched under RCU; the verdicts, which may sleep for the
+ * integrity check, are taken afterwards.  Returns -1 to fall back to d_path()
+ * if the chain can not be walked or changed under us.
+ */
+__visible_for_testing int lookup_tree_path(const struct path *dpath, int attribute, struct file *f)
+{
+	struct dentry *comp[DEFEX_MAX_PATH_DEPTH];
+	struct rule_item_struct *items[DEFEX_MAX_PATH_DEPTH];
+	struct rule_item_struct *base, *cur_item;
+	struct path root;
+	unsigned seq, m_seq;
+	int i, top = -1, depth, count = 0, res = 0, check_integrity = 0;
+	int system_root;
+#ifdef DEFEX_INTEGRITY_ENABLE
+	static const char * const integrity_default[] = {
+		"system", "bin", "install-recovery.sh"
+	};
+#endif /* DEFEX_INTEGRITY_ENABLE */
+
+	base = rules_tree_base(attribute, &res);
+	if (!base)
+		return res;
+
+	/* May open files the first time, so not under RCU */
+	system_root = check_system_mount();
+
+	rcu_read_lock();
+	m_seq = read_seqbegin(&mount_lock);
+	seq = read_seqbegin(&rename_lock);
+	defex_get_fs_root_rcu(current->fs, &root);
+
+	depth = path_components(dpath, &root, comp);
+	if (depth >= 0) {
+		top = depth - 1;
+		if (depth > 1 && system_root && dentry_name_is(comp[top], "system_root"))
+			top--;
+
+#ifdef DEFEX_INTEGRITY_ENABLE
+		check_integrity = !components_are(comp, top, integrity_default,
+			ARRAY_SIZE(integrity_default));
+#endif /* DEFEX_INTEGRITY_ENABLE */
+
+		for (i = top; i >= 0; i--) {
+			cur_item = lookup_dentry(base, comp[i]);
+			if (!cur_item)
+				break;
+			items[count++] = cur_item;
+			base = cur_item;
+		}
+	}
+	rcu_read_unlock();
+
+	if (depth < 0 || read_seqretry(&rename_lock, seq) ||
+	    read_seqretry(&mount_lock, m_seq))
+		return -1;
+
+	res = 0;
+	for (i = 0; i < count; i++) {
+		res = lookup_item_verdict(items[i], attribute, f, i == top,
+			check_integrity);
+		if (res >= 0)
+			break;
+		res = 0;
+	}
+	return res;
+}
 #endif /* DEFEX_USE_PACKED_RULES */
 
 int rules_lookup2(const char *target_file, int attribute, struct file *f)
@@ -380,6 +600,16 @@ int rules_lookup(const struct path *dpath, int attribute, struct file *f)
 	int ret = 0;
 	char *target_file, *buff;
 
+#ifdef DEFEX_USE_PACKED_RULES
+	/* Deleted files keep the d_path() " (deleted)" suffix semantics */
+	if (!d_unlinked(dpath->dentry)) {
+		ret = lookup_tree_path(dpath, attribute, f);
+		if (ret >= 0)
+			return ret;
+		ret = 0;
+	}
+#endif /* DEFEX_USE_PACKED_RULES */
+
 	buff = kmalloc(PATH_MAX, GFP_KERNEL);
 	if (!buff)
 		return ret;
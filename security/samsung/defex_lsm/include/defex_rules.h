@@ -12,6 +12,12 @@
 #define STATIC_RULES_MAX_STR 		32
 #define INTEGRITY_LENGTH 		32
 #define FEATURE_NAME_MAX_STR 		32
+#define DEFEX_MAX_PATH_DEPTH 		16
+
+/* Name of the tree root item, the second one marks sorted sibling lists */
+#define DEFEX_RULES_TAG 		"DEFEX_RULES_FILE"
+#define DEFEX_RULES_SORTED_TAG 		"DEFEX_RULES_SORT"
+#define DEFEX_RULES_TAG_LEN 		16
 
 #define GET_ITEM_OFFSET(item_ptr)	(((char*)item_ptr) - ((char*)defex_packed_rules))
 #define GET_ITEM_PTR(offset)		((struct rule_item_struct *)(((char*)defex_packed_rules) + (offset)))
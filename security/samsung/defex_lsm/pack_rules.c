@@ -52,6 +52,8 @@ struct rule_item_struct *add_file_path(const char *file_path, int for_recovery);
 struct rule_item_struct *addline2tree(char *src_line, enum feature_types feature);
 char *extract_rule_text(const char *src_line);
 int lookup_tree(const char *file_path, int attribute, int for_recovery);
+int compare_items(const void *a, const void *b);
+int sort_tree(struct rule_item_struct *base);
 int store_tree(FILE *f, FILE *f_bin);
 
 #ifdef DEFEX_INTEGRITY_ENABLE
@@ -151,7 +153,7 @@ struct rule_item_struct *add_file_path(const char *file_path, int for_recovery)
 			printf("WARNING: Can not create the new item!\n");
 			exit(-1);
 		}
-		create_file_item("DEFEX_RULES_FILE", 16);
+		create_file_item(DEFEX_RULES_TAG, DEFEX_RULES_TAG_LEN);
 	}
 	base = defex_packed_rules;
 	ptr = file_path + 1;
@@ -318,6 +320,63 @@ struct rule_item_struct *addline2tree(char *src_line, enum feature_types feature
 	return item;
 }
 
+int compare_items(const void *a, const void *b)
+{
+	const struct rule_item_struct *item_a = *(const struct rule_item_struct **)a;
+	const struct rule_item_struct *item_b = *(const struct rule_item_struct **)b;
+
+	if (item_a->size != item_b->size)
+		return item_a->size - item_b->size;
+	return memcmp(item_a->name, item_b->name, item_a->size);
+}
+
+/* Relink every sibling list in (size, name) order, so the kernel lookup can
+ * stop at the first greater name instead of scanning the whole level.
+ */
+int sort_tree(struct rule_item_struct *base)
+{
+	struct rule_item_struct **items, *item;
+	unsigned int offset;
+	int i, count = 0;
+
+	if (!base->next_level)
+		return 0;
+	for (offset = base->next_level; offset; offset = GET_ITEM_PTR(offset)->next_file)
+		count++;
+	items = malloc(sizeof(struct rule_item_struct *) * count);
+	if (!items) {
+		printf("WARNING: Can not sort the rules tree!\n");
+		return -1;
+	}
+	i = 0;
+	for (offset = base->next_level; offset; offset = item->next_file) {
+		item = GET_ITEM_PTR(offset);
+		items[i++] = item;
+	}
+	/* Keep the normal/recovery duplicates in their original order */
+	for (i = 1; i < count; i++) {
+		int j = i;
+
+		item = items[i];
+		while (j > 0 && compare_items(&items[j - 1], &item) > 0) {
+			items[j] = items[j - 1];
+			j--;
+		}
+		items[j] = item;
+	}
+	base->next_level = GET_ITEM_OFFSET(items[0]);
+	for (i = 0; i < count; i++)
+		items[i]->next_file = (i + 1 < count) ? GET_ITEM_OFFSET(items[i + 1]) : 0;
+	for (i = 0; i < count; i++) {
+		if (sort_tree(items[i]) != 0) {
+			free(items);
+			return -1;
+		}
+	}
+	free(items);
+	return 0;
+}
+
 int store_tree(FILE *f, FILE *f_bin)
 {
 	unsigned char *ptr = (unsigned char *)defex_packed_rules;
@@ -607,6 +666,8 @@ int pack_rules(const char *source_rules_file, const char *packed_rules_file, con
 		}
 #endif
 	}
+	if (defex_packed_rules && !sort_tree(defex_packed_rules))
+		memcpy(defex_packed_rules->name, DEFEX_RULES_SORTED_TAG, DEFEX_RULES_TAG_LEN);
 	store_tree(dst_file, dst_binfile);
 	if (!packfiles_count)
 		printf("WARNING: Defex packed rules tree is empty!\n");
@@ -10,6 +10,7 @@
 #include <linux/module.h>
 #include "dsms_init.h"
 #include "dsms_kernel_api.h"
+#include "dsms_message_ring.h"
 #include "dsms_netlink.h"
 #include "dsms_preboot_buffer.h"
 #include "dsms_rate_limit.h"
@@ -40,8 +41,13 @@ __visible_for_testing int __kunit_init dsms_init(void)
 	ret = dsms_preboot_buffer_init();
 	if (ret != 0)
 		goto exit_netlink;
+	ret = dsms_message_ring_init();
+	if (ret != 0)
+		goto exit_preboot_buffer;
 	is_dsms_initialized_flag = true;
 	goto exit_ret;
+exit_preboot_buffer:
+	dsms_preboot_buffer_exit();
 exit_netlink:
 	dsms_netlink_exit();
 exit_rate_limit:
@@ -59,6 +65,7 @@ __visible_for_testing void __kunit_exit dsms_exit(void)
 	DSMS_LOG_DEBUG("Exiting.");
 	if (is_dsms_initialized_flag) {
 		is_dsms_initialized_flag = false;
+		dsms_message_ring_exit();
 		dsms_preboot_buffer_exit();
 		dsms_netlink_exit();
 		dsms_rate_limit_exit();
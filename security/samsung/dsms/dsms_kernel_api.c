@@ -17,9 +17,7 @@
 #include "dsms_access_control.h"
 #include "dsms_init.h"
 #include "dsms_kernel_api.h"
-#include "dsms_netlink.h"
-#include "dsms_preboot_buffer.h"
-#include "dsms_rate_limit.h"
+#include "dsms_message_ring.h"
 #include "dsms_test.h"
 
 noinline int dsms_send_message(const char *feature_code,
@@ -49,20 +47,13 @@ noinline int dsms_send_message(const char *feature_code,
 		goto exit_send;
 	}
 
-	ret = dsms_check_message_rate_limit();
-	if (ret != DSMS_SUCCESS)
-		goto exit_send;
-
 	address = __builtin_return_address(CALLER_FRAME);
 	ret = dsms_verify_access(address);
 	if (ret != DSMS_SUCCESS)
 		goto exit_send;
 
-	if (dsms_daemon_ready()) {
-		ret = dsms_send_netlink_message(feature_code, detail, value);
-	} else {
-		ret = dsms_preboot_buffer_add(feature_code, detail, value);
-	}
+	/* Rate limit and delivery are done by the ring sender thread */
+	ret = dsms_message_ring_add(feature_code, detail, value);
 
 exit_send:
 	return ret;
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2021 Samsung Electronics Co., Ltd. All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ */
+
+#include <linux/cpumask.h>
+#include <linux/dsms.h>
+#include <linux/errno.h>
+#include <linux/irqflags.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include "dsms_kernel_api.h"
+#include "dsms_message_ring.h"
+#include "dsms_netlink.h"
+#include "dsms_preboot_buffer.h"
+#include "dsms_rate_limit.h"
+#include "dsms_test.h"
+
+/* Must be a power of two */
+#define RING_SLOTS (16)
+/* Time given to a burst of messages to gather into one netlink send */
+#define RING_BATCH_DELAY (HZ / 10)
+#define RING_BATCH_SIZE (16 * 1024)
+
+struct dsms_ring_slot {
+	int64_t value;
+	char feature_code[FEATURE_CODE_LENGTH + 1];
+	char detail[MAX_ALLOWED_DETAIL_LENGTH + 1];
+};
+
+/*
+ * Single producer (the owning CPU, with interrupts off) and single
+ * consumer (the ring sender thread) queue. head is only written by the
+ * producer, tail only by the consumer.
+ */
+struct dsms_ring {
+	unsigned int head;
+	unsigned int tail;
+	unsigned int dropped;
+	unsigned int dropped_reported;
+	struct dsms_ring_slot *slots;
+};
+
+static DEFINE_PER_CPU(struct dsms_ring, dsms_rings);
+__visible_for_testing struct task_struct *ring_sender_thread;
+
+int dsms_message_ring_add(const char *feature_code,
+			  const char *detail, int64_t value)
+{
+	struct dsms_ring *ring;
+	struct dsms_ring_slot *slot;
+	unsigned long flags;
+	unsigned int head, used;
+	size_t len_detail;
+	int ret = DSMS_SUCCESS;
+	bool wakeup = false;
+
+	local_irq_save(flags);
+	ring = this_cpu_ptr(&dsms_rings);
+	if (unlikely(!ring->slots)) {
+		ret = -EAGAIN;
+		goto exit_add;
+	}
+
+	head = ring->head;
+	used = head - smp_load_acquire(&ring->tail);
+	if (used >= RING_SLOTS) {
+		ring->dropped++;
+		ret = -EBUSY;
+		goto exit_add;
+	}
+
+	slot = &ring->slots[head & (RING_SLOTS - 1)];
+	strncpy(slot->feature_code, feature_code, FEATURE_CODE_LENGTH);
+	slot->feature_code[FEATURE_CODE_LENGTH] = '\0';
+	len_detail = strnlen(detail, MAX_ALLOWED_DETAIL_LENGTH);
+	memcpy(slot->detail, detail, len_detail);
+	slot->detail[len_detail] = '\0';
+	slot->value = value;
+	smp_store_release(&ring->head, head + 1);
+
+	/* The sender sleeps until the first message, and hurries at half */
+	wakeup = (used == 0 || used + 1 == RING_SLOTS / 2);
+exit_add:
+	local_irq_restore(flags);
+	if (wakeup)
+		wake_up_process(ring_sender_thread);
+	return ret;
+}
+
+static bool dsms_rings_pending(void)
+{
+	struct dsms_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&dsms_rings, cpu);
+		if (READ_ONCE(ring->tail) != smp_load_acquire(&ring->head))
+			return true;
+	}
+	return false;
+}
+
+static void dsms_ring_deliver(struct sk_buff **skb, struct dsms_ring_slot *slot)
+{
+	int ret;
+
+	DSMS_LOG_DEBUG("Ring sender message {'%s', '%s', %lld}",
+		       slot->feature_code, slot->detail, slot->value);
+
+	if (dsms_check_message_rate_limit() != DSMS_SUCCESS)
+		return;
+
+	if (!dsms_daemon_ready()) {
+		dsms_preboot_buffer_add(slot->feature_code,
+					slot->detail, slot->value);
+		return;
+	}
+
+	if (*skb) {
+		ret = dsms_netlink_batch_add(*skb, slot->feature_code,
+					     slot->detail, slot->value);
+		if (ret != -EMSGSIZE)
+			goto exit_deliver;
+		/* Batch is full, flush it and start the next one */
+		dsms_netlink_batch_send(*skb, GFP_KERNEL);
+	}
+
+	*skb = dsms_netlink_batch_new(RING_BATCH_SIZE, GFP_KERNEL);
+	if (!*skb)
+		return;
+	ret = dsms_netlink_batch_add(*skb, slot->feature_code,
+				     slot->detail, slot->value);
+exit_deliver:
+	if (ret)
+		DSMS_LOG_ERROR("Ring sender failed to send a message: %d.", ret);
+}
+
+static void dsms_rings_flush(void)
+{
+	struct sk_buff *skb = NULL;
+	struct dsms_ring *ring;
+	unsigned int tail, dropped;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&dsms_rings, cpu);
+		tail = ring->tail;
+		while (tail != smp_load_acquire(&ring->head)) {
+			dsms_ring_deliver(&skb,
+					  &ring->slots[tail & (RING_SLOTS - 1)]);
+			smp_store_release(&ring->tail, ++tail);
+		}
+
+		dropped = READ_ONCE(ring->dropped);
+		if (dropped != ring->dropped_reported) {
+			DSMS_LOG_ERROR("%u messages dropped on cpu %d, ring full.",
+				       dropped - ring->dropped_reported, cpu);
+			ring->dropped_reported = dropped;
+		}
+	}
+
+	if (skb)
+		dsms_netlink_batch_send(skb, GFP_KERNEL);
+}
+
+__visible_for_testing int ring_sender(void *unused)
+{
+	DSMS_LOG_DEBUG("Ring sender running.");
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!dsms_rings_pending()) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		schedule_timeout_interruptible(RING_BATCH_DELAY);
+		dsms_rings_flush();
+	}
+
+	DSMS_LOG_DEBUG("Ring sender exiting.");
+	return 0;
+}
+
+static void dsms_message_ring_free(void)
+{
+	struct dsms_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&dsms_rings, cpu);
+		kfree(ring->slots);
+		ring->slots = NULL;
+	}
+}
+
+int __kunit_init dsms_message_ring_init(void)
+{
+	struct dsms_ring *ring;
+	int cpu;
+
+	DSMS_LOG_DEBUG("Message ring init.");
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu_ptr(&dsms_rings, cpu);
+		ring->slots = kmalloc_array(RING_SLOTS,
+					    sizeof(struct dsms_ring_slot),
+					    GFP_KERNEL);
+		if (!ring->slots) {
+			DSMS_LOG_ERROR("Message ring allocation error.");
+			goto exit_free;
+		}
+	}
+
+	ring_sender_thread = kthread_run(ring_sender,
+					 NULL, "dsms_ring_kthread");
+	if (IS_ERR(ring_sender_thread)) {
+		DSMS_LOG_ERROR("Ring sender thread failed.");
+		goto exit_free;
+	}
+
+	return 0;
+
+exit_free:
+	dsms_message_ring_free();
+	return -1;
+}
+
+void __kunit_exit dsms_message_ring_exit(void)
+{
+	DSMS_LOG_DEBUG("Message ring exit.");
+
+	kthread_stop(ring_sender_thread);
+	dsms_rings_flush();
+	dsms_message_ring_free();
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2021 Samsung Electronics Co., Ltd. All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ */
+
+#ifndef _DSMS_MESSAGE_RING_H
+#define _DSMS_MESSAGE_RING_H
+
+#include "dsms_test.h"
+
+extern int dsms_message_ring_add(const char *feature_code,
+				 const char *detail, int64_t value);
+extern int __kunit_init dsms_message_ring_init(void);
+extern void __kunit_exit dsms_message_ring_exit(void);
+
+#endif /* _DSMS_MESSAGE_RING_H */
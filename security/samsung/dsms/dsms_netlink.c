@@ -96,56 +96,63 @@ int dsms_daemon_ready(void)
 	return atomic_read(&daemon_ready);
 }
 
-int dsms_send_netlink_message(const char *feature_code,
-			      const char *detail,
-			      int64_t value)
+struct sk_buff *dsms_netlink_batch_new(size_t size, gfp_t gfp)
 {
-	int ret;
-	void *msg_head;
-	size_t detail_len;
 	struct sk_buff *skb;
 
-	DSMS_LOG_DEBUG("Sending netlink message.");
-
-	skb = genlmsg_new(NLMSG_GOODSIZE, GFP_ATOMIC);
-	if (skb == NULL) {
+	skb = genlmsg_new(size, gfp);
+	if (skb == NULL)
 		DSMS_LOG_ERROR("genlmsg_new error.");
-		return -ENOMEM;
-	}
+	return skb;
+}
+
+int dsms_netlink_batch_add(struct sk_buff *skb,
+			   const char *feature_code,
+			   const char *detail,
+			   int64_t value)
+{
+	int ret;
+	void *msg_head;
+	size_t detail_len;
 
 	msg_head = genlmsg_put(skb, 0, 0,
 			       &dsms_family, 0, DSMS_MSG_CMD);
-	if (msg_head == NULL) {
-		DSMS_LOG_ERROR("genlmsg_put error.");
-		nlmsg_free(skb);
-		return -ENOMEM;
-	}
+	if (msg_head == NULL)
+		return -EMSGSIZE;
 
 	ret = nla_put(skb, DSMS_VALUE, sizeof(value), &value);
-	if (ret) {
-		DSMS_LOG_ERROR("nla_put value error.");
-		nlmsg_free(skb);
-		return ret;
-	}
+	if (ret)
+		goto cancel;
 
 	ret = nla_put(skb, DSMS_FEATURE_CODE,
 		      FEATURE_CODE_LENGTH + 1, feature_code);
-	if (ret) {
-		DSMS_LOG_ERROR("nla_put feature error.");
-		nlmsg_free(skb);
-		return ret;
-	}
+	if (ret)
+		goto cancel;
 
 	detail_len = strnlen(detail, MAX_ALLOWED_DETAIL_LENGTH);
 	ret = nla_put(skb, DSMS_DETAIL, detail_len + 1, detail);
-	if (ret) {
-		DSMS_LOG_ERROR("nla_put detail error.");
+	if (ret)
+		goto cancel;
+
+	genlmsg_end(skb, msg_head);
+	return DSMS_SUCCESS;
+
+cancel:
+	/* Drop the partial message, the ones before it are kept */
+	genlmsg_cancel(skb, msg_head);
+	return ret;
+}
+
+int dsms_netlink_batch_send(struct sk_buff *skb, gfp_t gfp)
+{
+	int ret;
+
+	if (!skb->len) {
 		nlmsg_free(skb);
-		return ret;
+		return DSMS_SUCCESS;
 	}
 
-	genlmsg_end(skb, msg_head);
-	ret = genlmsg_multicast(&dsms_family, skb, 0, 0, GFP_ATOMIC);
+	ret = genlmsg_multicast(&dsms_family, skb, 0, 0, gfp);
 	if (ret) {
 		DSMS_LOG_ERROR("genlmsg_multicast error.");
 		return ret;
@@ -153,3 +160,26 @@ int dsms_send_netlink_message(const char *feature_code,
 
 	return DSMS_SUCCESS;
 }
+
+int dsms_send_netlink_message(const char *feature_code,
+			      const char *detail,
+			      int64_t value)
+{
+	int ret;
+	struct sk_buff *skb;
+
+	DSMS_LOG_DEBUG("Sending netlink message.");
+
+	skb = dsms_netlink_batch_new(NLMSG_GOODSIZE, GFP_ATOMIC);
+	if (skb == NULL)
+		return -ENOMEM;
+
+	ret = dsms_netlink_batch_add(skb, feature_code, detail, value);
+	if (ret) {
+		DSMS_LOG_ERROR("Netlink message build error: %d.", ret);
+		nlmsg_free(skb);
+		return ret;
+	}
+
+	return dsms_netlink_batch_send(skb, GFP_ATOMIC);
+}
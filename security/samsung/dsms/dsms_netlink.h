@@ -9,6 +9,7 @@
 #ifndef _DSMS_NETLINK_H
 #define _DSMS_NETLINK_H
 
+#include <linux/skbuff.h>
 #include "dsms_test.h"
 
 extern int __kunit_init dsms_netlink_init(void);
@@ -17,5 +18,11 @@ extern int dsms_daemon_ready(void);
 extern int dsms_send_netlink_message(const char *feature_code,
 				     const char *detail,
 				     int64_t value);
+extern struct sk_buff *dsms_netlink_batch_new(size_t size, gfp_t gfp);
+extern int dsms_netlink_batch_add(struct sk_buff *skb,
+				  const char *feature_code,
+				  const char *detail,
+				  int64_t value);
+extern int dsms_netlink_batch_send(struct sk_buff *skb, gfp_t gfp);
 
 #endif /* _DSMS_NETLINK_H */
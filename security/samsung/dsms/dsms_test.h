@@ -89,6 +89,10 @@ extern struct dsms_message_node *create_node(struct dsms_message *message);
 extern void destroy_node(struct dsms_message_node *node);
 extern struct dsms_message *dsms_preboot_buffer_get(void);
 
+
+extern struct task_struct *ring_sender_thread;
+extern int ring_sender(void *unused);
+
 /* -------------------------------------------------------------------------- */
 /* dsms_rate_limit */
 /* -------------------------------------------------------------------------- */
@@ -288,6 +288,7 @@ int five_appraise_measurement(struct task_struct *task, int func,
 	u8 stored_file_hash[FIVE_MAX_DIGEST_SIZE] = {0};
 	size_t file_hash_len = 0;
 	struct five_cert_header *header = NULL;
+	bool measured = false;
 
 	BUG_ON(!task || !iint || !file);
 
@@ -328,11 +329,15 @@ int five_appraise_measurement(struct task_struct *task, int func,
 		goto out;
 	}
 
-	rc = five_collect_measurement(file, header->hash_algo, file_hash,
-				      file_hash_len);
-	if (rc) {
-		cause = CAUSE_CALC_HASH_FAILED;
-		goto out;
+	if (!five_mcache_lookup(file, header->hash_algo, file_hash,
+				file_hash_len)) {
+		rc = five_collect_measurement(file, header->hash_algo,
+					      file_hash, file_hash_len);
+		if (rc) {
+			cause = CAUSE_CALC_HASH_FAILED;
+			goto out;
+		}
+		measured = true;
 	}
 
 	switch (header->signature_type) {
@@ -445,6 +450,10 @@ out:
 				tint_reset_cause_to_string(cause), rc);
 	}
 
+	if (measured && (status == FIVE_FILE_RSA || status == FIVE_FILE_HMAC))
+		five_mcache_store(file, header->hash_algo, file_hash,
+				  file_hash_len);
+
 	five_set_cache_status(iint, status);
 
 	return rc;
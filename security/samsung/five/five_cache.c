@@ -42,3 +42,426 @@ void five_set_cache_status(struct integrity_iint_cache *iint,
 	iint->five_status = status;
 }
 
+
+#ifdef CONFIG_FIVE_PERSISTENT_CACHE
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/security.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <crypto/hash_info.h>
+#include "five.h"
+#include "five_cert.h"
+#include "five_crypto.h"
+#include "five_tee_api.h"
+
+/*
+ * Measurement cache preserved across reboots.
+ *
+ * File digests collected during appraisal are remembered together with the
+ * identity and change markers (ctime, i_version, size) of the inode they were
+ * computed for.  Userspace reads the cache from securityfs before shutdown
+ * and writes it back at boot.  The blob is HMAC-signed by the TEE, so it can
+ * be stored anywhere, and an entry is only used while the inode metadata is
+ * unchanged; the certificate signature is still verified on every appraisal.
+ */
+
+#define FIVE_MCACHE_MAGIC	0x434d5646	/* "FVMC" */
+#define FIVE_MCACHE_VERSION	2
+#define FIVE_MCACHE_MAX		4096
+#define FIVE_MCACHE_SIG_MAX	512
+#define FIVE_MCACHE_HASH_BITS	8
+
+static const char five_mcache_label[] = "five-mcache";
+
+/* Separates cache signatures from any other hash signed with the same key */
+static const char five_mcache_domain[16] = "FIVE-MCACHE-v1";
+
+struct five_mcache_rec {
+	u8 uuid[16];
+	__le64 ino;
+	__le64 ctime_sec;
+	__le64 iversion;
+	__le64 size;
+	__le32 ctime_nsec;
+	__le32 generation;
+	/* fields above identify the file, see FIVE_MCACHE_KEY_LEN */
+	u8 hash_algo;
+	u8 hash_len;
+	u8 hash[FIVE_MAX_DIGEST_SIZE];
+} __packed;
+
+#define FIVE_MCACHE_KEY_LEN	offsetof(struct five_mcache_rec, hash_algo)
+
+struct five_mcache_header {
+	__le32 magic;
+	__le16 version;
+	u8 hash_algo;
+	u8 reserved;
+	__le32 count;
+	__le32 sig_len;
+	u8 sig[FIVE_MCACHE_SIG_MAX];
+} __packed;
+
+/*
+ * What is actually signed: the header fields and the digest of the records,
+ * after a fixed domain prefix.
+ */
+struct five_mcache_signed {
+	char domain[sizeof(five_mcache_domain)];
+	__le32 magic;
+	__le16 version;
+	u8 hash_algo;
+	u8 reserved;
+	__le32 count;
+	u8 recs_hash[FIVE_MAX_DIGEST_SIZE];
+} __packed;
+
+struct five_mcache_entry {
+	struct hlist_node node;
+	struct five_mcache_rec rec;
+};
+
+static DEFINE_HASHTABLE(five_mcache, FIVE_MCACHE_HASH_BITS);
+static DEFINE_SPINLOCK(five_mcache_lock);
+static unsigned int five_mcache_count;
+
+/* Smaller files are cheaper to hash than to look up and sign */
+static unsigned long five_mcache_minsize = 1 << 20;
+module_param_named(mcache_minsize, five_mcache_minsize, ulong, 0644);
+MODULE_PARM_DESC(mcache_minsize,
+		"Minimum file size for the persistent measurement cache");
+
+static u32 five_mcache_key_hash(const struct five_mcache_rec *rec)
+{
+	return jhash(rec, offsetof(struct five_mcache_rec, ctime_sec), 0);
+}
+
+static bool five_mcache_fill_key(struct file *file,
+				 struct five_mcache_rec *rec)
+{
+	struct inode *inode = d_real_inode(file_dentry(file));
+
+	if (i_size_read(inode) < five_mcache_minsize)
+		return false;
+
+	/* The uuid is what ties an entry to a filesystem across boots */
+	if (!memchr_inv(inode->i_sb->s_uuid, 0, sizeof(inode->i_sb->s_uuid)))
+		return false;
+
+	memset(rec, 0, sizeof(*rec));
+	memcpy(rec->uuid, inode->i_sb->s_uuid, sizeof(rec->uuid));
+	rec->ino = cpu_to_le64(inode->i_ino);
+	rec->generation = cpu_to_le32(inode->i_generation);
+	rec->ctime_sec = cpu_to_le64(inode->i_ctime.tv_sec);
+	rec->ctime_nsec = cpu_to_le32(inode->i_ctime.tv_nsec);
+	rec->iversion = cpu_to_le64(inode_query_iversion(inode));
+	rec->size = cpu_to_le64(i_size_read(inode));
+
+	return true;
+}
+
+/* Must be called with five_mcache_lock held */
+static struct five_mcache_entry *five_mcache_find(
+		const struct five_mcache_rec *key)
+{
+	struct five_mcache_entry *e;
+
+	hash_for_each_possible(five_mcache, e, node, five_mcache_key_hash(key)) {
+		if (!memcmp(e->rec.uuid, key->uuid, sizeof(key->uuid)) &&
+		    e->rec.ino == key->ino)
+			return e;
+	}
+
+	return NULL;
+}
+
+/* Must be called with five_mcache_lock held */
+static void five_mcache_insert(struct five_mcache_entry *new)
+{
+	struct five_mcache_entry *e = five_mcache_find(&new->rec);
+
+	if (e) {
+		e->rec = new->rec;
+		kfree(new);
+	} else if (five_mcache_count < FIVE_MCACHE_MAX) {
+		hash_add(five_mcache, &new->node,
+			 five_mcache_key_hash(&new->rec));
+		five_mcache_count++;
+	} else {
+		kfree(new);
+	}
+}
+
+/**
+ * five_mcache_lookup() - Look up a cached measurement of @file
+ * @file:      The file being appraised.
+ * @hash_algo: Algorithm of the wanted digest.
+ * @hash:      Output buffer for the digest.
+ * @hash_len:  Size of the wanted digest.
+ *
+ * Return: true if @hash was filled from the cache, false otherwise.
+ */
+bool five_mcache_lookup(struct file *file, u8 hash_algo,
+			u8 *hash, size_t hash_len)
+{
+	struct five_mcache_rec key;
+	struct five_mcache_entry *e;
+	bool found = false;
+
+	if (!five_mcache_fill_key(file, &key))
+		return false;
+
+	spin_lock(&five_mcache_lock);
+	e = five_mcache_find(&key);
+	if (e && !memcmp(&e->rec, &key, FIVE_MCACHE_KEY_LEN) &&
+	    e->rec.hash_algo == hash_algo && e->rec.hash_len == hash_len) {
+		memcpy(hash, e->rec.hash, hash_len);
+		found = true;
+	}
+	spin_unlock(&five_mcache_lock);
+
+	return found;
+}
+
+/**
+ * five_mcache_store() - Remember a freshly collected measurement of @file
+ * @file:      The appraised file.
+ * @hash_algo: Algorithm of @hash.
+ * @hash:      The file digest.
+ * @hash_len:  Length of @hash.
+ */
+void five_mcache_store(struct file *file, u8 hash_algo,
+		       const u8 *hash, size_t hash_len)
+{
+	struct five_mcache_entry *e;
+
+	if (hash_len > FIVE_MAX_DIGEST_SIZE)
+		return;
+
+	e = kmalloc(sizeof(*e), GFP_NOFS);
+	if (!e)
+		return;
+
+	if (!five_mcache_fill_key(file, &e->rec)) {
+		kfree(e);
+		return;
+	}
+	e->rec.hash_algo = hash_algo;
+	e->rec.hash_len = hash_len;
+	memcpy(e->rec.hash, hash, hash_len);
+
+	spin_lock(&five_mcache_lock);
+	five_mcache_insert(e);
+	spin_unlock(&five_mcache_lock);
+}
+
+struct five_mcache_blob {
+	size_t size;
+	u8 data[];
+};
+
+static int five_mcache_digest(const struct five_mcache_header *hdr,
+			      const struct five_mcache_rec *recs,
+			      u8 *digest, size_t *digest_len)
+{
+	struct five_mcache_signed sd = {
+		.magic = hdr->magic,
+		.version = hdr->version,
+		.hash_algo = hdr->hash_algo,
+		.reserved = hdr->reserved,
+		.count = hdr->count,
+	};
+	size_t len = sizeof(sd.recs_hash);
+	int rc;
+
+	memcpy(sd.domain, five_mcache_domain, sizeof(sd.domain));
+	rc = five_calc_data_hash((const u8 *)recs,
+				 le32_to_cpu(hdr->count) * sizeof(*recs),
+				 hdr->hash_algo, sd.recs_hash, &len);
+	if (rc)
+		return rc;
+
+	return five_calc_data_hash((const u8 *)&sd,
+				   offsetof(struct five_mcache_signed,
+					    recs_hash) + len,
+				   hdr->hash_algo, digest, digest_len);
+}
+
+static int five_mcache_open(struct inode *inode, struct file *file)
+{
+	struct five_mcache_blob *blob;
+	struct five_mcache_header *hdr;
+	struct five_mcache_rec *recs;
+	struct five_mcache_entry *e;
+	u8 digest[FIVE_MAX_DIGEST_SIZE];
+	size_t digest_len = sizeof(digest), sig_len = FIVE_MCACHE_SIG_MAX;
+	unsigned int count, bkt;
+	int rc;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (!(file->f_mode & FMODE_READ))
+		return 0;
+
+	blob = vzalloc(sizeof(*blob) + sizeof(*hdr) +
+		       FIVE_MCACHE_MAX * sizeof(*recs));
+	if (!blob)
+		return -ENOMEM;
+
+	hdr = (struct five_mcache_header *)blob->data;
+	recs = (struct five_mcache_rec *)(hdr + 1);
+
+	count = 0;
+	spin_lock(&five_mcache_lock);
+	hash_for_each(five_mcache, bkt, e, node) {
+		if (count == FIVE_MCACHE_MAX)
+			break;
+		recs[count++] = e->rec;
+	}
+	spin_unlock(&five_mcache_lock);
+
+	file->private_data = blob;
+	if (!count)
+		return 0;
+
+	hdr->magic = cpu_to_le32(FIVE_MCACHE_MAGIC);
+	hdr->version = cpu_to_le16(FIVE_MCACHE_VERSION);
+	hdr->hash_algo = five_hash_algo;
+	hdr->count = cpu_to_le32(count);
+
+	rc = five_mcache_digest(hdr, recs, digest, &digest_len);
+	if (!rc)
+		rc = sign_hash(five_hash_algo, digest, digest_len,
+			       five_mcache_label, sizeof(five_mcache_label),
+			       hdr->sig, &sig_len);
+	if (rc || sig_len > FIVE_MCACHE_SIG_MAX) {
+		pr_err("FIVE: Can't sign measurement cache: rc=%d\n", rc);
+		file->private_data = NULL;
+		vfree(blob);
+		return rc ? rc : -EINVAL;
+	}
+
+	hdr->sig_len = cpu_to_le32(sig_len);
+	blob->size = sizeof(*hdr) + count * sizeof(*recs);
+
+	return 0;
+}
+
+static ssize_t five_mcache_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct five_mcache_blob *blob = file->private_data;
+
+	if (!blob)
+		return 0;
+
+	return simple_read_from_buffer(buf, count, ppos, blob->data,
+				       blob->size);
+}
+
+/* The whole signed blob has to be written at once */
+static ssize_t five_mcache_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct five_mcache_header *hdr;
+	struct five_mcache_rec *recs;
+	u8 digest[FIVE_MAX_DIGEST_SIZE];
+	size_t digest_len = sizeof(digest);
+	u32 nr, sig_len, i;
+	void *data;
+	int rc;
+
+	if (*ppos || count < sizeof(*hdr) ||
+	    count > sizeof(*hdr) + FIVE_MCACHE_MAX * sizeof(*recs))
+		return -EINVAL;
+
+	data = vmalloc(count);
+	if (!data)
+		return -ENOMEM;
+
+	rc = -EFAULT;
+	if (copy_from_user(data, buf, count))
+		goto out;
+
+	hdr = data;
+	recs = (struct five_mcache_rec *)(hdr + 1);
+	nr = le32_to_cpu(hdr->count);
+	sig_len = le32_to_cpu(hdr->sig_len);
+
+	rc = -EINVAL;
+	if (le32_to_cpu(hdr->magic) != FIVE_MCACHE_MAGIC ||
+	    le16_to_cpu(hdr->version) != FIVE_MCACHE_VERSION ||
+	    hdr->hash_algo != five_hash_algo || hdr->reserved || !nr ||
+	    sig_len > FIVE_MCACHE_SIG_MAX ||
+	    count != sizeof(*hdr) + (size_t)nr * sizeof(*recs))
+		goto out;
+
+	rc = five_mcache_digest(hdr, recs, digest, &digest_len);
+	if (rc)
+		goto out;
+
+	rc = verify_hash(five_hash_algo, digest, digest_len,
+			 five_mcache_label, sizeof(five_mcache_label),
+			 hdr->sig, sig_len);
+	if (rc) {
+		pr_err("FIVE: Measurement cache signature mismatch: rc=%d\n",
+		       rc);
+		rc = -EKEYREJECTED;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct five_mcache_entry *e;
+
+		if (recs[i].hash_len > FIVE_MAX_DIGEST_SIZE)
+			continue;
+
+		e = kmalloc(sizeof(*e), GFP_KERNEL);
+		if (!e)
+			break;
+		e->rec = recs[i];
+
+		spin_lock(&five_mcache_lock);
+		five_mcache_insert(e);
+		spin_unlock(&five_mcache_lock);
+	}
+	rc = count;
+out:
+	vfree(data);
+	return rc;
+}
+
+static int five_mcache_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations five_mcache_fops = {
+	.open = five_mcache_open,
+	.read = five_mcache_read,
+	.write = five_mcache_write,
+	.release = five_mcache_release,
+	.llseek = generic_file_llseek,
+};
+
+int __init five_mcache_init(void)
+{
+	struct dentry *dir, *file;
+
+	dir = securityfs_create_dir("five", NULL);
+	if (IS_ERR(dir))
+		return PTR_ERR(dir);
+
+	file = securityfs_create_file("measurement_cache", S_IRUSR | S_IWUSR,
+				      dir, NULL, &five_mcache_fops);
+	if (IS_ERR(file)) {
+		securityfs_remove(dir);
+		return PTR_ERR(file);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_FIVE_PERSISTENT_CACHE */
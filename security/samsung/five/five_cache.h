@@ -27,4 +27,28 @@ enum five_file_integrity five_get_cache_status(
 void five_set_cache_status(struct integrity_iint_cache *iint,
 		enum five_file_integrity status);
 
+#ifdef CONFIG_FIVE_PERSISTENT_CACHE
+int five_mcache_init(void);
+bool five_mcache_lookup(struct file *file, u8 hash_algo,
+			u8 *hash, size_t hash_len);
+void five_mcache_store(struct file *file, u8 hash_algo,
+		       const u8 *hash, size_t hash_len);
+#else
+static inline int five_mcache_init(void)
+{
+	return 0;
+}
+
+static inline bool five_mcache_lookup(struct file *file, u8 hash_algo,
+				      u8 *hash, size_t hash_len)
+{
+	return false;
+}
+
+static inline void five_mcache_store(struct file *file, u8 hash_algo,
+				      const u8 *hash, size_t hash_len)
+{
+}
+#endif
+
 #endif // __LINUX_FIVE_CACHE_H
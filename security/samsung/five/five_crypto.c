@@ -30,6 +30,7 @@
 #include <crypto/hash.h>
 #include <crypto/hash_info.h>
 #include <linux/freezer.h>
+#include <linux/mm.h>
 #include "five.h"
 #include "five_crypto_comp.h"
 #include "five_porting.h"
@@ -73,6 +74,39 @@ static const struct kernel_param_ops param_ops_bufsize = {
 module_param_named(ahash_bufsize, five_bufsize, ulong, 0644);
 MODULE_PARM_DESC(ahash_bufsize, "Maximum ahash buffer size");
 
+/*
+ * A file's digest has to be computed sequentially, but reading it does not.
+ * Files are read ahead in windows of this size, one window in front of the
+ * one being hashed, so storage works in parallel with the hashing CPU.
+ */
+#define FIVE_READAHEAD_SIZE	(2UL << 20)
+
+static void five_readahead(struct file *file, loff_t offset, loff_t i_size)
+{
+	unsigned long nr;
+
+	if (offset >= i_size || file->f_flags & O_DIRECT)
+		return;
+
+	nr = DIV_ROUND_UP(min_t(loff_t, FIVE_READAHEAD_SIZE, i_size - offset),
+			  PAGE_SIZE);
+	force_page_cache_readahead(file->f_mapping, file, offset >> PAGE_SHIFT,
+				   nr);
+}
+
+/*
+ * Issue readahead for the window after the one containing [offset, end),
+ * once the hashing of [offset, end) enters a new window.
+ */
+static void five_readahead_next(struct file *file, loff_t offset, loff_t end,
+				loff_t i_size)
+{
+	loff_t window = round_down(end, FIVE_READAHEAD_SIZE);
+
+	if (offset == 0 || window > round_down(offset, FIVE_READAHEAD_SIZE))
+		five_readahead(file, window + FIVE_READAHEAD_SIZE, i_size);
+}
+
 static struct crypto_shash *five_shash_tfm;
 static struct crypto_ahash *five_ahash_tfm;
 
@@ -296,6 +330,8 @@ static int five_calc_file_hash_atfm(struct file *file,
 		read = 1;
 	}
 
+	five_readahead(file, 0, i_size);
+
 	for (offset = 0; offset < i_size; offset += rbuf_len) {
 		if (!rbuf[1] && offset) {
 			/* Not using two buffers, and it is not the first
@@ -308,6 +344,7 @@ static int five_calc_file_hash_atfm(struct file *file,
 		}
 		/* read buffer */
 		rbuf_len = min_t(loff_t, i_size - offset, rbuf_size[active]);
+		five_readahead_next(file, offset, offset + rbuf_len, i_size);
 		rc = integrity_kernel_read(file, offset, rbuf[active],
 					   rbuf_len);
 		if (rc != rbuf_len)
@@ -376,6 +413,7 @@ static int five_calc_file_hash_tfm(struct file *file,
 	const size_t len = crypto_shash_digestsize(tfm);
 	loff_t i_size, offset = 0;
 	char *rbuf;
+	size_t rbuf_size;
 	int rc, read = 0;
 
 	if (*hash_len < len)
@@ -395,7 +433,7 @@ static int five_calc_file_hash_tfm(struct file *file,
 	if (i_size == 0)
 		goto out;
 
-	rbuf = kzalloc(PAGE_SIZE, GFP_KERNEL);
+	rbuf = five_alloc_pages(i_size, &rbuf_size, 1);
 	if (!rbuf)
 		return -ENOMEM;
 
@@ -404,10 +442,13 @@ static int five_calc_file_hash_tfm(struct file *file,
 		read = 1;
 	}
 
+	five_readahead(file, 0, i_size);
+
 	while (offset < i_size) {
 		int rbuf_len;
 
-		rbuf_len = integrity_kernel_read(file, offset, rbuf, PAGE_SIZE);
+		five_readahead_next(file, offset, offset + rbuf_size, i_size);
+		rbuf_len = integrity_kernel_read(file, offset, rbuf, rbuf_size);
 		if (rbuf_len < 0) {
 			rc = rbuf_len;
 			break;
@@ -424,7 +465,7 @@ static int five_calc_file_hash_tfm(struct file *file,
 	}
 	if (read)
 		file->f_mode &= ~FMODE_READ;
-	kfree(rbuf);
+	five_free_pages(rbuf, rbuf_size);
 out:
 	if (!rc)
 		rc = crypto_shash_final(shash, hash);
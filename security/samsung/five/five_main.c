@@ -893,6 +893,11 @@ static int __init init_five(void)
 	if (error)
 		return error;
 
+	/* The measurement cache is an optimization, FIVE works without it */
+	error = five_mcache_init();
+	if (error)
+		pr_err("FIVE: failed to set up measurement cache: %d\n", error);
+
 	five_dsms_init("1", 0);
 
 	error = five_init_dmverity();
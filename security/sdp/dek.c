@@ -36,6 +36,9 @@
 #include <sdp/kek_pack.h>
 
 #include "../../fs/ext4/sdp/fscrypto_sdp_cache.h"
+#ifdef CONFIG_SDP_ENHANCED
+#include "../../fs/ext4/sdp/sdp_crypto.h"
+#endif
 
 /*
  * Need to move this to defconfig
@@ -715,6 +718,10 @@ static int dek_on_device_locked(dek_arg_on_device_locked *evt) {
 #elif defined(CONFIG_EXT4CRYPT_SDP)
 	fscrypt_sdp_cache_drop_inode_mappings(engine_id);
 #endif
+#ifdef CONFIG_SDP_ENHANCED
+	/* Keyed transforms must not outlive the unlocked state */
+	sdp_crypto_aes_gcm_key_cache_drop();
+#endif
 
 #ifdef CONFIG_SDP_KEY_DUMP
     if(get_sdp_sysfs_key_dump()) {
@@ -791,6 +798,9 @@ static int dek_on_user_added(dek_arg_on_user_added *evt) {
 
 static int dek_on_user_removed(dek_arg_on_user_removed *evt) {
 	del_kek_pack(evt->engine_id);
+#ifdef CONFIG_SDP_ENHANCED
+	sdp_crypto_aes_gcm_key_cache_drop();
+#endif
 
 	return 0;
 }
@@ -160,13 +160,15 @@ inline int __dek_aes_encrypt_key_raw(unsigned char *kek, unsigned int kek_len,
 	int rc;
 	int type;
 	int ekey_len = 0;
+	struct sdp_crypto_gcm_key *gkey;
 	struct crypto_aead *tfm;
 
-	tfm = sdp_crypto_aes_gcm_key_setup(kek, kek_len);
-	if (unlikely(IS_ERR(tfm))) {
-		rc = PTR_ERR(tfm);
+	gkey = sdp_crypto_aes_gcm_key_get(kek, kek_len);
+	if (unlikely(IS_ERR(gkey))) {
+		rc = PTR_ERR(gkey);
 		goto end;
 	}
+	tfm = sdp_crypto_aes_gcm_key_tfm(gkey);
 
 	type = CONV_DLEN_TO_TYPE(key_len);
 	ekey_len = CONV_TYPE_TO_PLEN(type);
@@ -184,7 +186,7 @@ inline int __dek_aes_encrypt_key_raw(unsigned char *kek, unsigned int kek_len,
 			rc = -EINVAL;
 			break;
 	}
-	sdp_crypto_aes_gcm_key_free(tfm);
+	sdp_crypto_aes_gcm_key_put(gkey);
 
 end:
 	if (rc)
@@ -273,13 +275,15 @@ inline int __dek_aes_decrypt_key_raw(unsigned char  *kek, unsigned int kek_len,
 	int rc;
 	int type;
 	int key_len = 0;
+	struct sdp_crypto_gcm_key *gkey;
 	struct crypto_aead *tfm;
 
-	tfm = sdp_crypto_aes_gcm_key_setup(kek, kek_len);
-	if (unlikely(IS_ERR(tfm))) {
-		rc = PTR_ERR(tfm);
+	gkey = sdp_crypto_aes_gcm_key_get(kek, kek_len);
+	if (unlikely(IS_ERR(gkey))) {
+		rc = PTR_ERR(gkey);
 		goto end;
 	}
+	tfm = sdp_crypto_aes_gcm_key_tfm(gkey);
 
 	type = CONV_PLEN_TO_TYPE(ekey_len);
 	key_len = CONV_TYPE_TO_DLEN(type);
@@ -297,7 +301,7 @@ inline int __dek_aes_decrypt_key_raw(unsigned char  *kek, unsigned int kek_len,
 			rc = -EINVAL;
 			break;
 	}
-	sdp_crypto_aes_gcm_key_free(tfm);
+	sdp_crypto_aes_gcm_key_put(gkey);
 
 end:
 	if (rc)
@@ -0,0 +1,249 @@
+/*
+ * Bulk transfer over a (MPTCP) TCP connection, measuring goodput and the
+ * in-order delivery delay seen by the application.  Every write starts with
+ * the CLOCK_MONOTONIC time at which the previous write returned, i.e. at
+ * which all of the previous record had been queued, so time spent blocked
+ * waiting for send buffer space is not counted.  Sender and receiver must
+ * share a clock - i.e., both run on the same machine, typically in two
+ * network namespaces connected by several emulated links (see
+ * mptcp_bench.sh).  The delivery delay above the minimum is made of send
+ * queueing and of time spent behind reordering across subflows.
+ *
+ *   server: mptcp_bench -s [-p port]
+ *   client: mptcp_bench -c <addr> [-p port] [-t seconds] [-b bytes]
+ *
+ * The server prints a single line of key=value pairs once the client
+ * closes the connection.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <linux/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MPTCP_ENABLED
+#define MPTCP_ENABLED	42
+#endif
+
+static int port = 8888;
+static int duration = 5;
+static size_t bufsize = 64 * 1024;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		error(1, errno, "clock_gettime");
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Best effort: with net.mptcp.mptcp_enabled=1 every TCP socket is MPTCP */
+static void enable_mptcp(int fd)
+{
+	int one = 1;
+
+	setsockopt(fd, IPPROTO_TCP, MPTCP_ENABLED, &one, sizeof(one));
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static size_t read_full(int fd, char *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < len) {
+		ret = read(fd, buf + done, len - done);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			error(1, errno, "read");
+		}
+		if (ret == 0)
+			break;
+		done += ret;
+	}
+	return done;
+}
+
+static void run_server(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+		.sin_port = htons(port),
+	};
+	uint64_t *delay = NULL, start = 0, end, sum = 0, min, prev = 0;
+	size_t nr = 0, alloc = 0, bytes = 0, len;
+	char *buf;
+	int fd, conn, opt = 1;
+
+	buf = malloc(bufsize);
+	if (!buf)
+		error(1, errno, "malloc");
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+	enable_mptcp(fd);
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)))
+		error(1, errno, "setsockopt(SO_REUSEADDR)");
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+	if (listen(fd, 1))
+		error(1, errno, "listen");
+
+	conn = accept(fd, NULL, NULL);
+	if (conn < 0)
+		error(1, errno, "accept");
+
+	while ((len = read_full(conn, buf, bufsize)) > 0) {
+		uint64_t sent, t = now_ns();
+
+		if (!start)
+			start = t;
+		bytes += len;
+		if (len < sizeof(sent))
+			break;
+
+		/* The header stamps the end of the previous record's write */
+		memcpy(&sent, buf, sizeof(sent));
+		if (prev && sent) {
+			if (nr == alloc) {
+				alloc = alloc ? alloc * 2 : 4096;
+				delay = realloc(delay, alloc * sizeof(*delay));
+				if (!delay)
+					error(1, errno, "realloc");
+			}
+			delay[nr++] = prev > sent ? prev - sent : 0;
+		}
+		if (len < bufsize)
+			break;
+		prev = t;
+	}
+	end = now_ns();
+	close(conn);
+	close(fd);
+
+	if (!nr)
+		error(1, 0, "no data received");
+
+	qsort(delay, nr, sizeof(*delay), cmp_u64);
+	min = delay[0];
+	for (len = 0; len < nr; len++)
+		sum += delay[len] - min;
+
+	printf("bytes=%zu goodput_mbps=%.2f delay_min_us=%llu delay_avg_us=%llu delay_p99_us=%llu\n",
+	       bytes, end > start ? bytes * 8.0 / ((end - start) / 1000.0) : 0,
+	       (unsigned long long)(min / 1000),
+	       (unsigned long long)(sum / nr / 1000),
+	       (unsigned long long)((delay[nr * 99 / 100] - min) / 1000));
+
+	free(delay);
+	free(buf);
+}
+
+static void run_client(const char *host)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+	};
+	uint64_t stop, t = 0;
+	char *buf;
+	int fd;
+
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+		error(1, 0, "bad address: %s", host);
+
+	buf = calloc(1, bufsize);
+	if (!buf)
+		error(1, errno, "calloc");
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		error(1, errno, "socket");
+	enable_mptcp(fd);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+
+	stop = now_ns() + duration * 1000000000ULL;
+	while (t < stop) {
+		size_t done = 0;
+		ssize_t ret;
+
+		memcpy(buf, &t, sizeof(t));
+		while (done < bufsize) {
+			ret = write(fd, buf + done, bufsize - done);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				error(1, errno, "write");
+			}
+			done += ret;
+		}
+		t = now_ns();
+	}
+	close(fd);
+	free(buf);
+}
+
+int main(int argc, char **argv)
+{
+	const char *host = NULL;
+	bool server = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "sc:p:t:b:")) != -1) {
+		switch (c) {
+		case 's':
+			server = true;
+			break;
+		case 'c':
+			host = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 't':
+			duration = atoi(optarg);
+			break;
+		case 'b':
+			bufsize = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s -s | -c addr [-p port] [-t secs] [-b bytes]",
+			      argv[0]);
+		}
+	}
+
+	if (bufsize < sizeof(uint64_t))
+		error(1, 0, "buffer too small");
+
+	if (server)
+		run_server();
+	else if (host)
+		run_client(host);
+	else
+		error(1, 0, "either -s or -c is required");
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+#!/bin/bash
+# Runs mptcp_bench between two network namespaces connected by two veth
+# pairs, each shaped by netem, for every combination of MPTCP scheduler and
+# coupled congestion control given.  Reports goodput, delivery delay and
+# system CPU time per combination, and fails if a transfer moves no data.
+#
+# Usage: mptcp_bench.sh [-t secs] [-s "schedulers"] [-c "ccs"]
+#                       [-1 "netem args"] [-2 "netem args"]
+#
+# Without options this is a quick self-test; e.g. to compare schedulers on
+# a WiFi+LTE like setup:
+#   mptcp_bench.sh -t 30 -s "default roundrobin redundant latency" \
+#       -c "lia olia balia wvegas" \
+#       -1 "delay 5ms 5ms rate 50mbit loss 0.5%" -2 "delay 40ms 2ms rate 20mbit"
+
+DURATION=2
+SCHEDS="default roundrobin redundant latency"
+CCS="lia"
+PATH1="delay 10ms rate 100mbit"
+PATH2="delay 30ms 5ms rate 50mbit"
+
+NS_CLI=mptcp-cli-$$
+NS_SRV=mptcp-srv-$$
+PORT=8888
+SYSCTLS="net.mptcp.mptcp_enabled net.mptcp.mptcp_path_manager \
+	 net.mptcp.mptcp_scheduler net.ipv4.tcp_congestion_control"
+
+while getopts "t:s:c:1:2:" opt; do
+	case $opt in
+	t) DURATION=$OPTARG ;;
+	s) SCHEDS=$OPTARG ;;
+	c) CCS=$OPTARG ;;
+	1) PATH1=$OPTARG ;;
+	2) PATH2=$OPTARG ;;
+	*) exit 1 ;;
+	esac
+done
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "mptcp_bench: must be run as root [SKIP]"
+	exit 0
+fi
+
+if [ ! -e /proc/sys/net/mptcp/mptcp_enabled ]; then
+	echo "mptcp_bench: kernel without MPTCP [SKIP]"
+	exit 0
+fi
+
+if ! /sbin/modprobe -q sch_netem && ! tc qdisc help 2>&1 | grep -q netem; then
+	echo "mptcp_bench: netem not available [SKIP]"
+	exit 0
+fi
+
+declare -A saved
+for s in $SYSCTLS; do
+	saved[$s]=$(sysctl -n "$s")
+done
+
+cleanup()
+{
+	for s in $SYSCTLS; do
+		sysctl -q -w "$s=${saved[$s]}"
+	done
+	ip netns del $NS_CLI 2>/dev/null
+	ip netns del $NS_SRV 2>/dev/null
+}
+trap cleanup EXIT
+
+# Modules of the schedulers and congestion controls, if built as such
+sched_module()
+{
+	case $1 in
+	roundrobin) echo mptcp_rr ;;
+	default) ;;
+	*) echo "mptcp_$1" ;;
+	esac
+}
+
+cc_module()
+{
+	case $1 in
+	lia) echo mptcp_coupled ;;
+	*) echo "mptcp_$1" ;;
+	esac
+}
+
+# Path i: client 10.0.i.1 <-> server 10.0.i.2. Policy routing by source
+# address keeps every subflow on the link its address belongs to, and
+# cross-path destinations are unreachable from it, so that fullmesh only
+# opens the two subflows whose data and ACKs both use the same link.
+setup()
+{
+	local i ns
+
+	ip netns add $NS_CLI || exit 1
+	ip netns add $NS_SRV || exit 1
+
+	for i in 1 2; do
+		ip link add veth$i netns $NS_CLI type veth peer name veth$i netns $NS_SRV
+		ip -n $NS_CLI addr add 10.0.$i.1/24 dev veth$i
+		ip -n $NS_SRV addr add 10.0.$i.2/24 dev veth$i
+
+		for ns in $NS_CLI $NS_SRV; do
+			ip -n $ns link set veth$i up
+			ip -n $ns rule add from 10.0.$i.0/24 table $((100 + i))
+			ip -n $ns route add 10.0.$i.0/24 dev veth$i table $((100 + i))
+			ip -n $ns route add unreachable 10.0.0.0/16 table $((100 + i))
+			ip netns exec $ns sysctl -q -w net.ipv4.conf.veth$i.rp_filter=0
+		done
+	done
+
+	for ns in $NS_CLI $NS_SRV; do
+		ip netns exec $ns sysctl -q -w net.ipv4.conf.all.rp_filter=0
+		ip -n $ns link set lo up
+		tc -n $ns qdisc add dev veth1 root netem $PATH1 || exit 1
+		tc -n $ns qdisc add dev veth2 root netem $PATH2 || exit 1
+	done
+}
+
+# Sum of busy and total jiffies over all CPUs
+cpu_ticks()
+{
+	awk '/^cpu / { print $2 + $3 + $4 + $7 + $8, $2 + $3 + $4 + $5 + $6 + $7 + $8 }' /proc/stat
+}
+
+# Wait up to 5s for the server to listen on $PORT
+wait_listen()
+{
+	local i
+
+	for i in $(seq 50); do
+		ip netns exec $NS_SRV ss -ltnH "sport = :$PORT" | grep -q . && return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+run_one()
+{
+	local sched=$1 cc=$2 out ret srv b0 t0 b1 t1 mod
+
+	for mod in $(sched_module "$sched") $(cc_module "$cc"); do
+		/sbin/modprobe -q "$mod"
+	done
+	if ! sysctl -q -w net.mptcp.mptcp_scheduler="$sched" 2>/dev/null ||
+	   ! sysctl -q -w net.ipv4.tcp_congestion_control="$cc" 2>/dev/null; then
+		printf "%-12s %-8s [SKIP]\n" "$sched" "$cc"
+		return 0
+	fi
+
+	out=$(mktemp)
+	timeout $((DURATION + 10)) \
+		ip netns exec $NS_SRV ./mptcp_bench -s -p $PORT > "$out" &
+	srv=$!
+	if ! wait_listen; then
+		kill $srv 2>/dev/null
+		wait $srv
+		printf "%-12s %-8s [FAIL] server not listening\n" "$sched" "$cc"
+		rm -f "$out"
+		return 1
+	fi
+
+	read b0 t0 < <(cpu_ticks)
+	timeout $((DURATION + 10)) \
+		ip netns exec $NS_CLI ./mptcp_bench -c 10.0.1.2 -p $PORT -t "$DURATION"
+	ret=$?
+	[ $ret -ne 0 ] && kill $srv 2>/dev/null
+	wait $srv || ret=1
+	read b1 t1 < <(cpu_ticks)
+
+	if [ $ret -ne 0 ] || ! grep -q "^bytes=[1-9]" "$out"; then
+		printf "%-12s %-8s [FAIL]\n" "$sched" "$cc"
+		rm -f "$out"
+		return 1
+	fi
+
+	printf "%-12s %-8s %s cpu=%d%%\n" "$sched" "$cc" "$(cat "$out")" \
+		$(( (b1 - b0) * 100 / (t1 - t0 > 0 ? t1 - t0 : 1) ))
+	rm -f "$out"
+	return 0
+}
+
+sysctl -q -w net.mptcp.mptcp_enabled=1
+sysctl -q -w net.mptcp.mptcp_path_manager=fullmesh
+setup
+
+echo "--------------------"
+echo "running mptcp_bench: path1 \"$PATH1\", path2 \"$PATH2\", ${DURATION}s"
+echo "--------------------"
+
+rc=0
+for sched in $SCHEDS; do
+	for cc in $CCS; do
+		run_one "$sched" "$cc" || rc=1
+	done
+done
+
+if [ $rc -ne 0 ]; then
+	echo "[FAIL]"
+	exit 1
+fi
+echo "[PASS]"